@@ -26,12 +26,84 @@ EventQueue queue;
 uint16_t customServiceUUID  = 0xA000;
 uint16_t readCharUUID       = 0xA001;
 
-static uint8_t readValue[10] = {0};
+// Gesture value: the last few gestures, so gestures made between two
+// console polls are not lost. Laid out little endian as
+//     [0x80 | count][sequence:2][timestamp:4] count x [action][magnitude][age:2]
+// where sequence and timestamp are those of the newest gesture and the
+// entries go from the oldest to the newest, each aged in milliseconds
+// before the newest. The console keeps the gestures whose sequence it has
+// not seen yet, see controller_protocol.h in the console.
+static const uint8_t gestureBatchFlag = 0x80;
+static const uint8_t gestureRingSize = 8;
+static const uint16_t gestureHeaderSize = 7;
+static const uint16_t gestureEntrySize = 4;
+
+static uint8_t readValue[gestureHeaderSize + gestureRingSize * gestureEntrySize] = {gestureBatchFlag};
 ReadOnlyArrayGattCharacteristic<uint8_t, sizeof(readValue)> readChar(readCharUUID, readValue);
 
+struct Gesture {
+    uint8_t action;
+    uint8_t magnitude;
+    uint32_t timestamp;
+};
+
+static Gesture gestureRing[gestureRingSize];
+static uint8_t gestureHead = 0;    // next slot to write
+static uint8_t gestureCount = 0;
+static uint16_t gestureSequence = 0;
+
 GattCharacteristic *characteristics[] = {&readChar};
 GattService customService(customServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
+void publish_gesture(uint8_t action, uint8_t magnitude)
+{
+    uint32_t now = (uint32_t) Kernel::Clock::now().time_since_epoch().count();
+
+    gestureRing[gestureHead] = {action, magnitude, now};
+    gestureHead = (gestureHead + 1) % gestureRingSize;
+    if (gestureCount < gestureRingSize) {
+        gestureCount++;
+    }
+    gestureSequence++;
+    // 0 means no gesture yet, skip it when the sequence wraps
+    if (gestureSequence == 0) {
+        gestureSequence = 1;
+    }
+
+    readValue[0] = gestureBatchFlag | gestureCount;
+    readValue[1] = gestureSequence & 0xFF;
+    readValue[2] = gestureSequence >> 8;
+    readValue[3] = now & 0xFF;
+    readValue[4] = (now >> 8) & 0xFF;
+    readValue[5] = (now >> 16) & 0xFF;
+    readValue[6] = (now >> 24) & 0xFF;
+
+    // oldest first
+    uint8_t *entry = readValue + gestureHeaderSize;
+    uint8_t slot = (gestureHead + gestureRingSize - gestureCount) % gestureRingSize;
+    for (int i = 0; i < gestureCount; i++, entry += gestureEntrySize) {
+        const Gesture &gesture = gestureRing[slot];
+        uint32_t age = now - gesture.timestamp;
+        if (age > 0xFFFF) {
+            age = 0xFFFF;
+        }
+        entry[0] = gesture.action;
+        entry[1] = gesture.magnitude;
+        entry[2] = age & 0xFF;
+        entry[3] = age >> 8;
+        slot = (slot + 1) % gestureRingSize;
+    }
+
+    // the characteristic has a fixed length, unused entries are ignored
+    BLE::Instance().gattServer().write(readChar.getValueHandle(), readValue, sizeof(readValue));
+}
+
+void queue_gesture(uint8_t action, uint8_t magnitude)
+{
+    // stamped when published, the queue adds no more than a BLE event
+    queue.call(publish_gesture, action, magnitude);
+}
+
 void advertise()
 {
     BLE &ble = BLE::Instance();
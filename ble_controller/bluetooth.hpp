@@ -15,6 +15,24 @@ static const ble::AdvertisingParameters advertising_params(
 
 void advertise();
 
+/**
+ * @brief Publish a new gesture on the gesture characteristic. Runs on the
+ * BLE event queue.
+ *
+ * Every call bumps the sequence number and stamps the gesture with the
+ * current time, so the console can tell new gestures from repeated reads.
+ *
+ * @param action The action code, 0x01 to 0x06.
+ * @param magnitude How strong the gesture was.
+ */
+void publish_gesture(uint8_t action, uint8_t magnitude);
+
+/**
+ * @brief Have a gesture published from the BLE event queue, from any
+ * thread such as the sensor one.
+ */
+void queue_gesture(uint8_t action, uint8_t magnitude);
+
 void on_init_complete(BLE::InitializationCompleteCallbackContext *event);
 
 void schedule_ble_events(BLE::OnEventsToProcessCallbackContext *context);
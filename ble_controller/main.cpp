@@ -1,7 +1,23 @@
 #include "bluetooth.hpp"
+#include "gesture_pipeline.hpp"
+
+// The controller's gesture pipeline, see controller/gesture_pipeline.hpp,
+// blocks between FIFO drains on its own thread; BLE keeps the main thread
+static Thread sensor_thread;
+
+static void on_gesture(const gesture &recognized)
+{
+    queue_gesture(recognized.action, recognized.magnitude);
+}
+
+static void run_sensors()
+{
+    run_gesture_pipeline(callback(on_gesture));
+}
 
 int main()
 {
+    sensor_thread.start(callback(run_sensors));
     ble_init();
     return 0;
 }
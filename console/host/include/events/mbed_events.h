@@ -0,0 +1,6 @@
+#ifndef HOST_MBED_EVENTS_H_
+#define HOST_MBED_EVENTS_H_
+
+#include "mbed.h"
+
+#endif /* HOST_MBED_EVENTS_H_ */
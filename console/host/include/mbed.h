@@ -0,0 +1,278 @@
+#ifndef HOST_MBED_H_
+#define HOST_MBED_H_
+
+/*
+ * Host stand-in for the parts of mbed-os used by the transport independent
+ * console code: events::EventQueue, Kernel::Clock, mbed::Timer and
+ * mbed::NonCopyable.
+ * It lets the real BlockBashGame loop run on Linux over a host transport.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#ifndef MBED_CONF_APP_INSTRUMENTATION
+#define MBED_CONF_APP_INSTRUMENTATION 0
+#endif
+#ifndef MBED_CONF_APP_GAME_THREAD
+#define MBED_CONF_APP_GAME_THREAD 1
+#endif
+#ifndef MBED_CONF_APP_GAME_STEP_MS
+#define MBED_CONF_APP_GAME_STEP_MS 20
+#endif
+#ifndef MBED_CONF_APP_RENDER_PERIOD_MS
+#define MBED_CONF_APP_RENDER_PERIOD_MS 500
+#endif
+
+// Sizes used by the board build for one event and for the whole queue,
+// kept so that queue usage reports read the same on both
+#define EVENTS_EVENT_SIZE 64
+#define EVENTS_QUEUE_SIZE (32 * EVENTS_EVENT_SIZE)
+
+namespace mbed {
+
+template<typename T>
+class NonCopyable {
+protected:
+    NonCopyable() = default;
+    ~NonCopyable() = default;
+
+    NonCopyable(const NonCopyable &) = delete;
+    NonCopyable &operator=(const NonCopyable &) = delete;
+};
+
+/**
+ * Microsecond stopwatch with the interface of mbed::Timer.
+ */
+class Timer {
+public:
+    void start()
+    {
+        if (!running) {
+            started_at = std::chrono::steady_clock::now();
+            running = true;
+        }
+    }
+
+    void stop()
+    {
+        if (running) {
+            accumulated += std::chrono::steady_clock::now() - started_at;
+            running = false;
+        }
+    }
+
+    void reset()
+    {
+        accumulated = std::chrono::steady_clock::duration::zero();
+        started_at = std::chrono::steady_clock::now();
+    }
+
+    std::chrono::microseconds elapsed_time() const
+    {
+        auto elapsed = accumulated;
+        if (running) {
+            elapsed += std::chrono::steady_clock::now() - started_at;
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+    }
+
+private:
+    bool running = false;
+    std::chrono::steady_clock::time_point started_at;
+    std::chrono::steady_clock::duration accumulated = std::chrono::steady_clock::duration::zero();
+};
+
+} // namespace mbed
+
+namespace rtos {
+namespace Kernel {
+
+/**
+ * Monotonic millisecond clock, like the RTOS kernel tick.
+ */
+struct Clock {
+    using duration = std::chrono::milliseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<Clock, duration>;
+    static const bool is_steady = true;
+
+    static time_point now()
+    {
+        return time_point(std::chrono::duration_cast<duration>(
+            std::chrono::steady_clock::now().time_since_epoch()));
+    }
+};
+
+} // namespace Kernel
+} // namespace rtos
+
+namespace events {
+
+/**
+ * Thread safe event queue with the call/call_in/call_every/cancel
+ * interface of the mbed EventQueue. Events may be posted from any thread
+ * and are dispatched on the thread running dispatch_forever().
+ */
+class EventQueue {
+public:
+    using duration = std::chrono::duration<int, std::milli>;
+
+    explicit EventQueue(unsigned = EVENTS_QUEUE_SIZE, unsigned char * = nullptr)
+    {}
+
+    template<typename F>
+    int call(F f)
+    {
+        return post(duration(0), duration(0), std::function<void()>(f));
+    }
+
+    template<typename F>
+    int call_in(duration delay, F f)
+    {
+        return post(delay, duration(0), std::function<void()>(f));
+    }
+
+    template<typename F>
+    int call_every(duration period, F f)
+    {
+        return post(period, period, std::function<void()>(f));
+    }
+
+    bool cancel(int id)
+    {
+        EventQueue *target = get_chained();
+        if (target) {
+            return target->cancel(id);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        return events.erase(id) != 0;
+    }
+
+    /**
+     * Have target dispatch the events of this queue, or stop doing so
+     * with nullptr. Unlike the mbed queue, only events posted after the
+     * call move over, which is enough for queues chained before use.
+     */
+    void chain(EventQueue *target)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        chained = target;
+    }
+
+    void dispatch_forever()
+    {
+        dispatch(nullptr);
+    }
+
+    void dispatch_for(duration ms)
+    {
+        auto deadline = Clock::now() + ms;
+        dispatch(&deadline);
+    }
+
+    void break_dispatch()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        break_requested = true;
+        wakeup.notify_all();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event {
+        Clock::time_point due;
+        duration period;
+        std::function<void()> callback;
+    };
+
+    EventQueue *get_chained()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return chained;
+    }
+
+    int post(duration delay, duration period, std::function<void()> callback)
+    {
+        EventQueue *target = get_chained();
+        if (target) {
+            return target->post(delay, period, std::move(callback));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        int id = next_id++;
+        events.emplace(id, Event { Clock::now() + delay, period, std::move(callback) });
+        wakeup.notify_all();
+        return id;
+    }
+
+    void dispatch(const Clock::time_point *deadline)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (break_requested) {
+                break_requested = false;
+                return;
+            }
+            if (deadline && Clock::now() >= *deadline) {
+                return;
+            }
+
+            // the earliest event runs first, ties go to the oldest post
+            auto next = events.end();
+            for (auto it = events.begin(); it != events.end(); it++) {
+                if (next == events.end() || it->second.due < next->second.due) {
+                    next = it;
+                }
+            }
+
+            Clock::time_point wake = deadline ? *deadline : Clock::time_point::max();
+            if (next != events.end() && next->second.due < wake) {
+                wake = next->second.due;
+            }
+            if (next == events.end() || next->second.due > Clock::now()) {
+                if (wake == Clock::time_point::max()) {
+                    wakeup.wait(lock);
+                } else {
+                    wakeup.wait_until(lock, wake);
+                }
+                continue;
+            }
+
+            std::function<void()> callback = next->second.callback;
+            if (next->second.period > duration(0)) {
+                next->second.due += next->second.period;
+            } else {
+                events.erase(next);
+            }
+
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::map<int, Event> events;
+    int next_id = 1;
+    bool break_requested = false;
+    EventQueue *chained = nullptr;
+};
+
+} // namespace events
+
+using namespace std::chrono_literals;
+using namespace std;
+using namespace mbed;
+using namespace rtos;
+using namespace events;
+
+#endif /* HOST_MBED_H_ */
@@ -0,0 +1,6 @@
+#ifndef HOST_NONCOPYABLE_H_
+#define HOST_NONCOPYABLE_H_
+
+#include "mbed.h"
+
+#endif /* HOST_NONCOPYABLE_H_ */
@@ -0,0 +1,125 @@
+#ifndef UDP_CONTROLLER_TRANSPORT_H_
+#define UDP_CONTROLLER_TRANSPORT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "mbed.h"
+#include "controller_transport.h"
+
+/**
+ * Datagram opcodes of the emulated controller link.
+ *
+ * Every datagram starts with an opcode byte, 16 bit fields are little
+ * endian. A virtual controller owns one UDP socket and is identified by
+ * its address, which stands in for the BLE connection.
+ *
+ * Controller to console:
+ *  - Connect     [mac:6]                      ask for a connection
+ *  - Disconnect                               drop the connection
+ *  - Services    [count:1] {[uuid:2][handle:2]}  characteristics of the
+ *                                             controller service
+ *  - ReadResponse [handle:2][value...]        answer to Read
+ *  - Notify      [handle:2][value...]         unsolicited value
+ *
+ * Console to controller:
+ *  - Connected   [connection:2]               connection accepted
+ *  - Rejected                                 connection refused or dropped
+ *  - Discover                                 send Services
+ *  - Read        [handle:2]                   send ReadResponse
+ *  - Write       [handle:2][value...]         store value
+ */
+enum class UdpLinkOp : uint8_t {
+    Connect      = 0x01,
+    Disconnect   = 0x02,
+    Services     = 0x03,
+    ReadResponse = 0x04,
+    Notify       = 0x05,
+
+    Connected    = 0x81,
+    Rejected     = 0x82,
+    Discover     = 0x83,
+    Read         = 0x84,
+    Write        = 0x85,
+};
+
+static const uint16_t UdpLinkDefaultPort = 47000;
+
+/**
+ * Controller transport emulating the BLE link over UDP, for running the
+ * console on a host against virtual controllers.
+ *
+ * Datagrams are received on a background thread and handed over to the
+ * event queue, so handler callbacks run on the dispatching thread exactly
+ * as they do with the BLE stack.
+ */
+class UdpControllerTransport
+    : private mbed::NonCopyable<UdpControllerTransport>,
+      public ControllerTransport
+{
+public:
+    /**
+     * @param port UDP port to listen on, 0 picks a free one.
+     */
+    UdpControllerTransport(events::EventQueue &queue, uint16_t port = UdpLinkDefaultPort);
+
+    ~UdpControllerTransport();
+
+    void start(EventHandler *handler) override;
+
+    void stop() override;
+
+    void discover(ConnectionHandle connection) override;
+
+    void read(ConnectionHandle connection, AttributeHandle value_handle) override;
+
+    void write(
+        ConnectionHandle connection, AttributeHandle value_handle,
+        const uint8_t *data, uint16_t length) override;
+
+    void disconnect(ConnectionHandle connection) override;
+
+    DispatchLatency get_dispatch_latency() const override
+    {
+        return dispatch_latency;
+    }
+
+    /**
+     * Port actually bound once started.
+     */
+    uint16_t get_port() const
+    {
+        return port;
+    }
+
+private:
+    void receive_loop();
+
+    void handle_datagram(const sockaddr_in &peer, const std::vector<uint8_t> &datagram);
+
+    void send_to(const sockaddr_in &peer, const std::vector<uint8_t> &datagram);
+
+    void send(ConnectionHandle connection, const std::vector<uint8_t> &datagram);
+
+    static uint64_t peer_key(const sockaddr_in &peer);
+
+    events::EventQueue &queue;
+    // free running, stamps datagrams when they are received
+    mbed::Timer dispatch_timer;
+    DispatchLatency dispatch_latency;
+    uint16_t port;
+    int socket_fd;
+    std::thread receiver;
+    std::atomic<bool> running;
+    EventHandler *handler;
+
+    std::map<uint64_t, ConnectionHandle> peer_to_connection;
+    std::map<ConnectionHandle, sockaddr_in> connection_to_peer;
+};
+
+#endif /* UDP_CONTROLLER_TRANSPORT_H_ */
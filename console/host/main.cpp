@@ -0,0 +1,58 @@
+/**
+ * @file main.cpp
+ *
+ * @brief Console game on a host, with virtual controllers connecting over
+ * UDP instead of BLE.
+ *
+ * Usage: blockbash-console [port]
+ *
+ * The render stream is written to stdout exactly as on the board's serial
+ * port. Pressing Enter plays the role of the console user button.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "udp_controller_transport.h"
+#include "BlockBashGame.h"
+
+int main(int argc, char **argv)
+{
+    uint16_t port = UdpLinkDefaultPort;
+    if (argc > 1) {
+        port = (uint16_t) std::atoi(argv[1]);
+    }
+
+    EventQueue queue;
+    EventQueue game_queue;
+    UdpControllerTransport transport(queue, port);
+    BlockBashGame game(transport, queue, game_queue);
+
+#if MBED_CONF_APP_GAME_THREAD
+    std::thread game_thread([&game_queue] { game_queue.dispatch_forever(); });
+    game_thread.detach();
+#else
+    game_queue.chain(&queue);
+#endif
+
+    std::cerr << "Waiting for controllers on UDP port " << transport.get_port()
+              << ", press Enter to start" << std::endl;
+
+    // stdin stands in for the user button
+    std::thread button([&game_queue, &game] {
+        std::string line;
+        if (std::getline(std::cin, line)) {
+            game_queue.call([&game] { game.request_start(); });
+        }
+    });
+    button.detach();
+
+#if MBED_CONF_APP_INSTRUMENTATION
+    game_queue.call_every(10s, [&game] { game.print_stats(); });
+#endif
+
+    queue.dispatch_forever();
+    return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file protocol_test.cpp
+ *
+ * @brief Decoding of gesture characteristic values, around the wrap of the
+ * sequence numbers.
+ */
+
+#include <cstdio>
+
+#include "controller_protocol.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static GesturePacket gesture(uint8_t action, uint16_t sequence, uint32_t timestamp_ms)
+{
+    return GesturePacket { action, 1, sequence, timestamp_ms, true };
+}
+
+static void test_batch_numbering()
+{
+    GesturePacket gestures[] = {
+        gesture(0x01, 40, 1000), gesture(0x02, 41, 1010), gesture(0x03, 42, 1025),
+    };
+    uint8_t value[MaxGestureBatchSize];
+    uint16_t length = write_gesture_batch(gestures, 3, value);
+
+    GestureBatch batch;
+    check(parse_gesture_batch(value, length, batch), "batch parses");
+    check(batch.count == 3, "batch holds every gesture");
+    for (int i = 0; i < 3; i++) {
+        check(batch.gestures[i].sequence == gestures[i].sequence, "entries are numbered in turn");
+        check(batch.gestures[i].action == gestures[i].action, "entries keep their action");
+        check(batch.gestures[i].timestamp_ms == gestures[i].timestamp_ms, "entries keep their time");
+    }
+}
+
+static void test_batch_across_wrap()
+{
+    // the controller goes from 0xFFFF to 1, 0 is never a gesture
+    GesturePacket gestures[] = {
+        gesture(0x01, 0xFFFE, 500), gesture(0x02, 0xFFFF, 510), gesture(0x03, 1, 520),
+    };
+    uint8_t value[MaxGestureBatchSize];
+    uint16_t length = write_gesture_batch(gestures, 3, value);
+
+    GestureBatch batch;
+    check(parse_gesture_batch(value, length, batch), "batch across the wrap parses");
+    check(batch.count == 3, "batch across the wrap holds every gesture");
+    for (int i = 0; i < 3; i++) {
+        check(batch.gestures[i].sequence == gestures[i].sequence,
+              "entries across the wrap keep their sequence");
+        check(batch.gestures[i].action == gestures[i].action,
+              "entries across the wrap keep their action");
+    }
+
+    // the console took 0xFFFE already: only the two newer ones are new
+    check(gesture_sequence_distance(0xFFFE, batch.gestures[0].sequence) == 0,
+          "the gesture already taken is not new");
+    check(gesture_sequence_distance(0xFFFE, batch.gestures[1].sequence) == 1,
+          "0xFFFF follows 0xFFFE");
+    check(gesture_sequence_distance(0xFFFF, batch.gestures[2].sequence) == 1,
+          "1 follows 0xFFFF, nothing missed");
+}
+
+static void test_sequence_steps()
+{
+    check(next_gesture_sequence(0) == 1, "the first gesture is 1");
+    check(next_gesture_sequence(0xFFFF) == 1, "0 is skipped going up");
+    check(previous_gesture_sequence(1) == 0xFFFF, "0 is skipped going down");
+    check(gesture_sequence_distance(0, 1) == 1, "1 follows the empty value");
+    check(gesture_sequence_distance(0xFFFD, 2) == 4, "distance across the wrap skips 0");
+    check(gesture_sequence_distance(2, 0xFFFD) < 0, "an older gesture is behind");
+}
+
+int main()
+{
+    test_batch_numbering();
+    test_batch_across_wrap();
+    test_sequence_steps();
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,678 @@
+/**
+ * @file swarm.cpp
+ *
+ * @brief Load generator for the console input path.
+ *
+ * Runs the real console game in process over the UDP transport and attaches
+ * a swarm of virtual controllers to it. The controllers expose the real
+ * controller service (gesture and signal characteristics) and produce
+ * gestures at a steady rate plus optional bursts. Once a second the tool
+ * reports what the console saw: queue depths, lost gestures, render rate
+ * and the time spent per frame. At the end it prints how long gestures took
+ * from the controller to the board, over all boards and for each one.
+ *
+ * Usage: blockbash-swarm [options]
+ *   -n COUNT    virtual controllers (default 8)
+ *   -r RATE     gestures per second per controller (default 2)
+ *   -b SIZE     gestures per burst (default 0, no bursts)
+ *   -p SECONDS  seconds between bursts (default 5)
+ *   -t SECONDS  seconds to run once frames are running (default 30)
+ *   -g SIZE     gestures kept in the characteristic ring (default 8,
+ *               1 publishes single gestures)
+ *   -l          answer with legacy [action, magnitude] values that carry
+ *               no sequence number, so the console applies every read
+ *   -N          notify every gesture instead of waiting to be read
+ *   -s BAUD     write the render stream through the transmit buffer of a
+ *               serial port at BAUD, as the board does (default 0, no
+ *               pacing)
+ *   -1          run the frames on the transport thread, with the game
+ *               queue chained to the transport queue, instead of on a
+ *               game thread of their own
+ *   -S          run with 3, 6 and 8 controllers in turn instead of -n, and
+ *               sum up the latency per player count; e.g. -S -t 20 -r 4
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <random>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "udp_controller_transport.h"
+#include "BlockBashGame.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static const uint16_t GestureValueHandle = 0x0010;
+static const uint16_t SignalValueHandle = 0x0012;
+
+struct SwarmOptions {
+    int controllers = 8;
+    double rate = 2.0;
+    int burst_size = 0;
+    double burst_period = 5.0;
+    int run_seconds = 30;
+    int ring_size = MaxGestureBatch;
+    bool legacy = false;
+    bool notify = false;
+    bool single_thread = false;
+    bool sweep = false;
+    unsigned baud = 0;
+};
+
+// Player counts of a sweep
+static const int SweepPlayers[] = { 3, 6, 8 };
+
+// Transmit buffer of the board serial port, drivers.uart-serial-txbuf-size
+// in mbed_app.json
+static const size_t SerialTxBufferSize = 4096;
+
+/**
+ * Discards the render stream, counting the bytes that would have gone to
+ * the display. With a baud rate, writes fill a transmit buffer that
+ * drains at the pace of the serial port, and block only while it is full.
+ */
+class CountingBuffer : public std::streambuf {
+public:
+    std::atomic<size_t> bytes { 0 };
+    unsigned baud = 0;
+
+protected:
+    int overflow(int c) override
+    {
+        bytes++;
+        pace(1);
+        return c;
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize n) override
+    {
+        bytes += n;
+        pace(n);
+        return n;
+    }
+
+private:
+    void pace(std::streamsize n)
+    {
+        if (!baud) {
+            return;
+        }
+        // start, 8 data and stop bits per byte
+        auto byte_time = std::chrono::microseconds(10 * 1000000 / baud);
+        auto now = std::chrono::steady_clock::now();
+        drained = std::max(drained, now) + n * byte_time;
+        auto backlog = drained - now;
+        auto buffered = (std::streamsize) SerialTxBufferSize * byte_time;
+        if (backlog > buffered) {
+            std::this_thread::sleep_for(backlog - buffered);
+        }
+    }
+
+    // when the bytes written so far will have been sent
+    std::chrono::steady_clock::time_point drained;
+};
+
+/**
+ * One emulated controller: a socket standing in for its BLE link and the
+ * ring of gestures behind its gesture characteristic.
+ */
+struct VirtualController {
+    int fd = -1;
+    int index = 0;
+    bool connected = false;
+    bool rejected = false;
+    bool ready = false;
+
+    std::deque<GesturePacket> ring;
+    uint16_t sequence = 0;
+    // newest gesture that reached the console
+    uint16_t delivered_sequence = 0;
+    // controller clocks start at unrelated times
+    uint32_t clock_base_ms = 0;
+
+    SteadyClock::time_point next_gesture;
+    SteadyClock::time_point next_burst;
+
+    unsigned sent = 0;
+    unsigned delivered = 0;
+    unsigned overwritten = 0;
+    unsigned repeated = 0;
+};
+
+static void put_u16(std::vector<uint8_t> &datagram, uint16_t value)
+{
+    datagram.push_back(value & 0xFF);
+    datagram.push_back(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+class Swarm {
+public:
+    Swarm(const SwarmOptions &options, uint16_t console_port)
+        : options(options), rng(1234)
+    {
+        console.sin_family = AF_INET;
+        console.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        console.sin_port = htons(console_port);
+
+        controllers.resize(options.controllers);
+        for (int i = 0; i < options.controllers; i++) {
+            VirtualController &controller = controllers[i];
+            controller.index = i;
+            controller.fd = socket(AF_INET, SOCK_DGRAM, 0);
+            controller.clock_base_ms = (uint32_t) rng();
+        }
+    }
+
+    ~Swarm()
+    {
+        for (auto &controller: controllers) {
+            if (controller.connected) {
+                send(controller, { (uint8_t) UdpLinkOp::Disconnect });
+            }
+            close(controller.fd);
+        }
+    }
+
+    void connect_all()
+    {
+        for (auto &controller: controllers) {
+            std::vector<uint8_t> datagram {
+                (uint8_t) UdpLinkOp::Connect,
+                0xB0, 0xBA, 0x5E, 0x00,
+                (uint8_t) (controller.index >> 8), (uint8_t) controller.index
+            };
+            send(controller, datagram);
+        }
+    }
+
+    /**
+     * Serve the console for the given time, producing gestures once
+     * generating is set.
+     */
+    void run_for(std::chrono::milliseconds time)
+    {
+        auto end = SteadyClock::now() + time;
+        std::vector<pollfd> descriptors(controllers.size());
+
+        while (SteadyClock::now() < end) {
+            for (size_t i = 0; i < controllers.size(); i++) {
+                descriptors[i] = { controllers[i].fd, POLLIN, 0 };
+            }
+            poll(descriptors.data(), descriptors.size(), 1);
+
+            for (size_t i = 0; i < controllers.size(); i++) {
+                if (descriptors[i].revents & POLLIN) {
+                    receive(controllers[i]);
+                }
+            }
+
+            if (generating) {
+                generate(SteadyClock::now());
+            }
+        }
+    }
+
+    void start_generating()
+    {
+        auto now = SteadyClock::now();
+        for (auto &controller: controllers) {
+            controller.next_gesture = now + next_interval();
+            controller.next_burst = now + std::chrono::duration_cast<SteadyClock::duration>(
+                std::chrono::duration<double>(options.burst_period));
+        }
+        generating = true;
+    }
+
+    int count_connected() const
+    {
+        int count = 0;
+        for (auto &controller: controllers) {
+            count += controller.connected;
+        }
+        return count;
+    }
+
+    int count_rejected() const
+    {
+        int count = 0;
+        for (auto &controller: controllers) {
+            count += controller.rejected;
+        }
+        return count;
+    }
+
+    struct Totals {
+        unsigned sent = 0;
+        unsigned delivered = 0;
+        unsigned overwritten = 0;
+        unsigned repeated = 0;
+    };
+
+    Totals totals() const
+    {
+        Totals totals;
+        for (auto &controller: controllers) {
+            totals.sent += controller.sent;
+            totals.delivered += controller.delivered;
+            totals.overwritten += controller.overwritten;
+            totals.repeated += controller.repeated;
+        }
+        return totals;
+    }
+
+private:
+    SteadyClock::duration next_interval()
+    {
+        // exponential gaps give a Poisson stream of gestures at the rate
+        std::exponential_distribution<double> gap(options.rate > 0 ? options.rate : 1e-9);
+        return std::chrono::duration_cast<SteadyClock::duration>(
+            std::chrono::duration<double>(gap(rng)));
+    }
+
+    void generate(SteadyClock::time_point now)
+    {
+        for (auto &controller: controllers) {
+            if (!controller.ready) {
+                continue;
+            }
+            while (options.rate > 0 && controller.next_gesture <= now) {
+                gesture(controller);
+                controller.next_gesture += next_interval();
+            }
+            if (options.burst_size > 0 && controller.next_burst <= now) {
+                for (int i = 0; i < options.burst_size; i++) {
+                    gesture(controller);
+                }
+                controller.next_burst += std::chrono::duration_cast<SteadyClock::duration>(
+                    std::chrono::duration<double>(options.burst_period));
+            }
+        }
+    }
+
+    void gesture(VirtualController &controller)
+    {
+        // action codes 0x01..0x06 as understood by parse_action
+        std::uniform_int_distribution<int> action(0x01, 0x06);
+
+        GesturePacket packet;
+        packet.action = (uint8_t) action(rng);
+        packet.magnitude = 1;
+        controller.sequence = next_gesture_sequence(controller.sequence);
+        packet.sequence = controller.sequence;
+        packet.timestamp_ms = controller_clock_ms(controller);
+        packet.sequenced = true;
+        controller.sent++;
+
+        controller.ring.push_back(packet);
+        int ring_size = options.legacy ? 1 : options.ring_size;
+        if ((int) controller.ring.size() > ring_size) {
+            if (is_newer(controller.ring.front().sequence, controller.delivered_sequence)) {
+                controller.overwritten++;
+            }
+            controller.ring.pop_front();
+        }
+
+        if (options.notify) {
+            std::vector<uint8_t> datagram { (uint8_t) UdpLinkOp::Notify };
+            put_u16(datagram, GestureValueHandle);
+            put_gesture(datagram, controller);
+            send(controller, datagram);
+        }
+    }
+
+    void receive(VirtualController &controller)
+    {
+        uint8_t buffer[512];
+        ssize_t length = recv(controller.fd, buffer, sizeof(buffer), 0);
+        if (length <= 0) {
+            return;
+        }
+
+        switch ((UdpLinkOp) buffer[0]) {
+        case UdpLinkOp::Connected:
+            controller.connected = true;
+            break;
+
+        case UdpLinkOp::Rejected:
+            controller.connected = false;
+            controller.rejected = true;
+            break;
+
+        case UdpLinkOp::Discover: {
+            std::vector<uint8_t> datagram { (uint8_t) UdpLinkOp::Services, 2 };
+            put_u16(datagram, GestureCharacteristicUUID);
+            put_u16(datagram, GestureValueHandle);
+            put_u16(datagram, SignalCharacteristicUUID);
+            put_u16(datagram, SignalValueHandle);
+            send(controller, datagram);
+            controller.ready = true;
+            break;
+        }
+
+        case UdpLinkOp::Read: {
+            if (length < 3 || get_u16(buffer + 1) != GestureValueHandle) {
+                break;
+            }
+            std::vector<uint8_t> datagram { (uint8_t) UdpLinkOp::ReadResponse };
+            put_u16(datagram, GestureValueHandle);
+            put_gesture(datagram, controller);
+            send(controller, datagram);
+            break;
+        }
+
+        default:
+            // signals (player id, ready, paused) need no answer
+            break;
+        }
+    }
+
+    uint32_t controller_clock_ms(const VirtualController &controller) const
+    {
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            SteadyClock::now().time_since_epoch());
+        return controller.clock_base_ms + (uint32_t) now.count();
+    }
+
+    static bool is_newer(uint16_t sequence, uint16_t than)
+    {
+        return (int16_t) (sequence - than) > 0;
+    }
+
+    /**
+     * The gesture characteristic value, as the firmware selected by the
+     * options would publish it, and the delivery accounting that goes with
+     * sending it.
+     */
+    void put_gesture(std::vector<uint8_t> &datagram, VirtualController &controller)
+    {
+        unsigned fresh = 0;
+        for (auto &packet: controller.ring) {
+            fresh += is_newer(packet.sequence, controller.delivered_sequence);
+        }
+        if (fresh) {
+            controller.delivered += fresh;
+            controller.delivered_sequence = controller.sequence;
+        } else if (!controller.ring.empty()) {
+            controller.repeated++;
+        }
+
+        uint8_t value[MaxGestureBatchSize];
+        uint16_t length;
+        if (options.legacy || options.ring_size == 1) {
+            GesturePacket packet = {};
+            if (!controller.ring.empty()) {
+                packet = controller.ring.back();
+            }
+            write_gesture_packet(packet, value);
+            length = options.legacy ? LegacyGesturePacketSize : GesturePacketSize;
+        } else {
+            std::vector<GesturePacket> gestures(controller.ring.begin(), controller.ring.end());
+            length = write_gesture_batch(gestures.data(), gestures.size(), value);
+        }
+        datagram.insert(datagram.end(), value, value + length);
+    }
+
+    void send(VirtualController &controller, const std::vector<uint8_t> &datagram)
+    {
+        sendto(controller.fd, datagram.data(), datagram.size(), 0,
+               (const sockaddr *) &console, sizeof(console));
+    }
+
+    const SwarmOptions &options;
+    sockaddr_in console {};
+    std::vector<VirtualController> controllers;
+    std::mt19937 rng;
+    bool generating = false;
+};
+
+/**
+ * Run f on the console thread and wait for its result.
+ */
+template<typename F>
+static auto on_console(EventQueue &queue, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> result;
+    queue.call([&result, &f] { result.set_value(f()); });
+    return result.get_future().get();
+}
+
+static uint64_t thread_cpu_us()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+struct Sample {
+    BlockBashGame::Stats game;
+    uint64_t cpu_us;
+};
+
+static bool parse_options(int argc, char **argv, SwarmOptions &options)
+{
+    int option;
+    while ((option = getopt(argc, argv, "n:r:b:p:t:g:s:lN1Sh")) != -1) {
+        switch (option) {
+        case 'n': options.controllers = std::atoi(optarg); break;
+        case 'r': options.rate = std::atof(optarg); break;
+        case 'b': options.burst_size = std::atoi(optarg); break;
+        case 'p': options.burst_period = std::atof(optarg); break;
+        case 't': options.run_seconds = std::atoi(optarg); break;
+        case 'g': options.ring_size = std::atoi(optarg); break;
+        case 's': options.baud = (unsigned) std::atoi(optarg); break;
+        case 'l': options.legacy = true; break;
+        case 'N': options.notify = true; break;
+        case '1': options.single_thread = true; break;
+        case 'S': options.sweep = true; break;
+        default:
+            return false;
+        }
+    }
+    return options.controllers > 0 && options.burst_period > 0
+        && options.ring_size >= 1 && options.ring_size <= MaxGestureBatch;
+}
+
+/**
+ * Run the console against a swarm and report on it.
+ *
+ * @return the console figures at the end of the run.
+ */
+static BlockBashGame::Stats run_swarm(const SwarmOptions &options)
+{
+    // the render stream is only counted, not shown
+    CountingBuffer render_sink;
+    render_sink.baud = options.baud;
+    std::streambuf *stdout_buffer = std::cout.rdbuf(&render_sink);
+
+    EventQueue transport_queue;
+    EventQueue queue;
+    UdpControllerTransport transport(transport_queue, 0);
+    BlockBashGame game(transport, transport_queue, queue);
+    if (options.single_thread) {
+        queue.chain(&transport_queue);
+    }
+    std::thread link([&transport_queue] { transport_queue.dispatch_forever(); });
+    std::thread console;
+    if (!options.single_thread) {
+        console = std::thread([&queue] { queue.dispatch_forever(); });
+    }
+
+    Swarm swarm(options, transport.get_port());
+    swarm.connect_all();
+
+    // wait until every accepted controller has a board
+    auto deadline = SteadyClock::now() + std::chrono::seconds(10);
+    while (SteadyClock::now() < deadline) {
+        swarm.run_for(std::chrono::milliseconds(100));
+        int players = on_console(queue, [&game] { return game.get_stats().players; });
+        int expected = swarm.count_connected();
+        if (expected > 0 && players == expected
+                && expected + swarm.count_rejected() == options.controllers) {
+            break;
+        }
+    }
+
+    printf("%d controllers connected, %d rejected, %d boards\n",
+           swarm.count_connected(), swarm.count_rejected(),
+           on_console(queue, [&game] { return game.get_stats().players; }));
+    printf("%.1f gestures/s per controller, bursts of %d every %.1fs, %s, %s\n",
+           options.rate, options.burst_size, options.burst_period,
+           options.legacy ? "legacy values"
+               : options.ring_size == 1 ? "single gestures"
+               : ("rings of " + std::to_string(options.ring_size)).c_str(),
+           options.notify ? "notified" : "polled");
+    printf("frames on %s\n", options.single_thread ? "the transport thread" : "a game thread");
+
+    // frames begin after the start grace period
+    queue.call([&game] { game.request_start(); });
+    swarm.run_for(std::chrono::milliseconds(5000));
+    swarm.start_generating();
+
+    printf("%5s %7s %9s %11s %8s %7s %8s %9s %8s %10s %10s %12s\n",
+           "t", "sent", "delivered", "overwritten", "enqueued", "applied",
+           "waiting", "max queue", "render/s", "render B/s", "frame us", "cpu us/frame");
+
+    auto sample = [&queue, &game] {
+        return on_console(queue, [&game] {
+            return Sample { game.get_stats(), thread_cpu_us() };
+        });
+    };
+
+    Sample start = sample();
+    Sample previous = start;
+    size_t previous_bytes = render_sink.bytes;
+    for (int t = 1; t <= options.run_seconds; t++) {
+        swarm.run_for(std::chrono::milliseconds(1000));
+
+        Sample now = sample();
+        size_t bytes = render_sink.bytes;
+        Swarm::Totals totals = swarm.totals();
+        unsigned frames = now.game.frames - previous.game.frames;
+        uint64_t frame_time = now.game.frame_time_total_us - previous.game.frame_time_total_us;
+        uint64_t cpu = now.cpu_us - previous.cpu_us;
+
+        printf("%5d %7u %9u %11u %8u %7u %8u %9u %8u %10u %10s %12s\n",
+               t, totals.sent, totals.delivered, totals.overwritten,
+               now.game.queues.enqueued, now.game.actions_applied,
+               (unsigned) now.game.queues.queued_total,
+               (unsigned) now.game.queues.queued_max,
+               now.game.frames_rendered - previous.game.frames_rendered,
+               (unsigned) (bytes - previous_bytes),
+               frames ? std::to_string(frame_time / frames).c_str() : "-",
+               frames ? std::to_string(cpu / frames).c_str() : "-");
+
+        previous = now;
+        previous_bytes = bytes;
+    }
+
+    Sample end = sample();
+    Swarm::Totals totals = swarm.totals();
+    unsigned frames = end.game.frames - start.game.frames;
+    printf("\n");
+    printf("gestures: %u sent, %u delivered, %u overwritten before a read, %u values with nothing new\n",
+           totals.sent, totals.delivered, totals.overwritten, totals.repeated);
+    printf("actions: %u enqueued, %u applied as %u moves,"
+           " %u still waiting, %u dropped by full queues\n",
+           end.game.queues.enqueued, end.game.actions_applied, end.game.moves_applied,
+           (unsigned) end.game.queues.queued_total, end.game.queues.dropped);
+    printf("frames: %u, avg %llu us, max %u us, console cpu %llu us per frame\n",
+           frames,
+           (unsigned long long) (frames ? (end.game.frame_time_total_us - start.game.frame_time_total_us) / frames : 0),
+           end.game.frame_time_max_us,
+           (unsigned long long) (frames ? (end.cpu_us - start.cpu_us) / frames : 0));
+    BlockBashGame::ConnectionStats link_stats = on_console(transport_queue, [&game] {
+        return game.get_connection_stats();
+    });
+    const FixedStepClock::Stats &clock = end.game.clock;
+    printf("steps: %u in %u wake ups, %u caught up in %u late frames, %u skipped,"
+           " jitter avg %llu us, max %u us\n",
+           clock.steps, clock.wakeups, clock.catch_up_steps, clock.overruns, clock.skipped_steps,
+           (unsigned long long) (clock.wakeups ? clock.jitter_total_us / clock.wakeups : 0),
+           clock.jitter_max_us);
+    printf("gesture reads: %u, avg %u ms, max %u ms round trip\n",
+           link_stats.read_latency.count,
+           link_stats.read_latency.count ? link_stats.read_latency.total_ms / link_stats.read_latency.count : 0,
+           link_stats.read_latency.max_ms);
+    printf("console: %u gestures received again, %u gestures missed\n",
+           link_stats.duplicate_gestures, link_stats.missed_gestures);
+    const DispatchLatency &dispatch = link_stats.transport_dispatch;
+    printf("transport: %u link events, waited avg %llu us, max %u us\n",
+           dispatch.count,
+           (unsigned long long) (dispatch.count ? dispatch.total_us / dispatch.count : 0),
+           dispatch.max_us);
+    end.game.gesture_latency.print("gesture-to-apply");
+    for (int board = 0; board < end.game.players; board++) {
+        const LatencyHistogram &latency = end.game.board_latency[board];
+        printf("[board %d] %u gestures, avg %u ms, max %u ms to apply\n", board,
+               latency.get_count(), latency.get_average_ms(), latency.get_max_ms());
+    }
+    end.game.roster_latency.print("validation-to-board");
+
+    if (console.joinable()) {
+        queue.break_dispatch();
+        console.join();
+    }
+    transport_queue.break_dispatch();
+    link.join();
+    std::cout.rdbuf(stdout_buffer);
+    return end.game;
+}
+
+int main(int argc, char **argv)
+{
+    SwarmOptions options;
+    if (!parse_options(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [-n count] [-r rate] [-b burst] [-p burst period]"
+                        " [-t seconds] [-g ring] [-s baud] [-l] [-N] [-1] [-S]\n", argv[0]);
+        return 1;
+    }
+
+    if (!options.sweep) {
+        run_swarm(options);
+        return 0;
+    }
+
+    std::vector<BlockBashGame::Stats> results;
+    for (int players : SweepPlayers) {
+        SwarmOptions run = options;
+        run.controllers = players;
+        printf("\n=== %d players ===\n", players);
+        results.push_back(run_swarm(run));
+    }
+
+    // the slowest board tells whether latency depends on the player count
+    printf("\n%7s %9s %10s %10s %16s %16s\n", "players", "gestures", "avg ms", "max ms",
+           "worst board avg", "worst board max");
+    for (const BlockBashGame::Stats &stats : results) {
+        uint32_t worst_average = 0;
+        uint32_t worst_max = 0;
+        for (int board = 0; board < stats.players; board++) {
+            worst_average = std::max(worst_average, stats.board_latency[board].get_average_ms());
+            worst_max = std::max(worst_max, stats.board_latency[board].get_max_ms());
+        }
+        printf("%7d %9u %10u %10u %16u %16u\n", stats.players,
+               stats.gesture_latency.get_count(), stats.gesture_latency.get_average_ms(),
+               stats.gesture_latency.get_max_ms(), worst_average, worst_max);
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file tetris_test.cpp
+ *
+ * @brief Soft drops: the piece goes down as many rows as asked, in one
+ * sweep, and is placed by the lock delay only.
+ */
+
+#include <cstdio>
+#include <sstream>
+
+#include "TetrisManager.h"
+
+using namespace Tetris;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/**
+ * Lowest and highest row of the falling piece, -1 without one.
+ */
+static void piece_rows(const TetrisGame &game, int &top, int &bottom)
+{
+    TetrisBoard view = game.getViewBoard();
+    const TetrisBoard &board = game.getBoard();
+    top = -1;
+    bottom = -1;
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            if (view[y][x] != board[y][x]) {
+                top = top < 0 ? y : top;
+                bottom = y;
+            }
+        }
+    }
+}
+
+static bool board_empty(const TetrisGame &game)
+{
+    for (auto &row : game.getBoard()) {
+        for (int cell : row) {
+            if (cell != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_soft_drop_rows()
+{
+    TetrisGame game;
+    game.start();
+
+    int top, bottom;
+    piece_rows(game, top, bottom);
+    check(top == 0, "a piece spawns on the top row");
+
+    game.applyAction(TetrisAction::SoftDrop, 3);
+    int dropped_top, dropped_bottom;
+    piece_rows(game, dropped_top, dropped_bottom);
+    check(dropped_top == top + 3 && dropped_bottom == bottom + 3, "a soft drop of 3 moves the piece 3 rows");
+    check(board_empty(game), "a soft drop does not place the piece");
+    check(!game.isResting(), "the piece is still free to fall");
+}
+
+static void test_soft_drop_lands()
+{
+    TetrisGame game;
+    game.start();
+
+    game.applyAction(TetrisAction::SoftDrop, 2 * HEIGHT);
+    int top, bottom;
+    piece_rows(game, top, bottom);
+    check(bottom == HEIGHT - 1, "a long soft drop stops on the floor");
+    check(game.isResting(), "the landed piece rests");
+    check(board_empty(game), "the landed piece is left for the lock delay");
+
+    game.lock();
+    check(!board_empty(game), "lock() places the landed piece");
+}
+
+static void test_lock_delay_places()
+{
+    const std::chrono::milliseconds step(20);
+    const int lock_delay_steps = LOCK_DELAY_MS / 20;
+
+    TetrisRenderer renderer;
+    TetrisGameManager manager(renderer, step);
+    manager.addGame();
+    manager.playGame();
+    TetrisGame &game = manager.getGames()[0];
+
+    manager.pushAction(0, TetrisAction::SoftDrop, 2 * HEIGHT);
+    check(game.isResting() && board_empty(game), "a soft drop to the floor does not lock");
+
+    for (int i = 0; i < lock_delay_steps - 1; i++) {
+        manager.runStep();
+    }
+    check(board_empty(game), "the piece waits for the lock delay");
+
+    for (int i = 0; i < 2; i++) {
+        manager.runStep();
+    }
+    check(!board_empty(game), "the lock delay places the piece");
+}
+
+int main()
+{
+    // the renderer writes to the display stream
+    std::ostringstream display;
+    std::streambuf *stdout_buffer = std::cout.rdbuf(display.rdbuf());
+
+    test_soft_drop_rows();
+    test_soft_drop_lands();
+    test_lock_delay_places();
+
+    std::cout.rdbuf(stdout_buffer);
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
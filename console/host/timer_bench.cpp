@@ -0,0 +1,323 @@
+/**
+ * @file timer_bench.cpp
+ *
+ * @brief Cost of the per-game timers, on the timer wheel and on the event
+ * queue.
+ *
+ * Every game has a gravity timer running at the period of its level and a
+ * lock delay timer armed when its piece lands. The piece lands every few
+ * rows and is sometimes moved off its ledge before the lock delay runs
+ * out, which cancels the timer. The same workload runs twice:
+ *
+ * - wheel: all timers in one TimerWheel, advanced by a single periodic
+ *   event every game step, as the game manager does;
+ * - events: one EventQueue event per armed timer, cancelled through the
+ *   queue.
+ *
+ * For each, the tool prints the timer operations done, the CPU time of the
+ * dispatching thread and how late timers expired against their period.
+ * Wheel timers expire on step boundaries, up to a step early when a period
+ * is not a whole number of steps; early expiries count as on time.
+ *
+ * Usage: blockbash-timer-bench [options]
+ *   -g COUNT    games, can be given several times (default 100, 250, 500)
+ *   -t SECONDS  seconds to run each case (default 3)
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "mbed.h"
+#include "timer_wheel.h"
+
+#include "TetrisManager.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+// Rows a piece falls before it lands, and chances of the player moving it
+// off its ledge on every gravity tick it rests
+static const int RowsPerPiece = 18;
+static const int SlideOffOneIn = 4;
+
+static const int MaxBenchGames = 2000;
+static const std::chrono::milliseconds StepPeriod(MBED_CONF_APP_GAME_STEP_MS);
+
+struct Counters {
+    unsigned arms = 0;
+    unsigned cancels = 0;
+    unsigned expiries = 0;
+    uint64_t lateness_total_us = 0;
+    uint64_t lateness_max_us = 0;
+
+    void expired(SteadyClock::time_point due)
+    {
+        expiries++;
+        auto late = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - due);
+        uint64_t late_us = late.count() > 0 ? late.count() : 0;
+        lateness_total_us += late_us;
+        if (late_us > lateness_max_us) {
+            lateness_max_us = late_us;
+        }
+    }
+};
+
+/**
+ * What a game does with its timers, whatever holds them.
+ */
+struct BenchGame {
+    std::chrono::milliseconds gravity;
+    int rows_left = RowsPerPiece;
+    bool locking = false;
+    SteadyClock::time_point gravity_due;
+    SteadyClock::time_point lock_due;
+};
+
+static std::chrono::milliseconds gravity_period(int game)
+{
+    // levels spread over the games, as in a running tournament
+    return std::chrono::milliseconds(1000 / (TICKS_PER_SECOND + game % 10));
+}
+
+static const std::chrono::milliseconds LockDelay(LOCK_DELAY_MS);
+
+static uint64_t thread_cpu_us()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * The workload, with the timer operations left to Timers:
+ * arm_gravity(game), arm_lock(game), cancel_lock(game).
+ */
+template<typename Timers>
+class Workload {
+public:
+    Workload(Timers &timers, int num_games, Counters &counters)
+        : timers(timers), games(num_games), counters(counters), random(1)
+    {
+        for (int i = 0; i < num_games; i++) {
+            games[i].gravity = gravity_period(i);
+        }
+    }
+
+    void start()
+    {
+        for (int i = 0; i < (int) games.size(); i++) {
+            arm_gravity(i);
+        }
+    }
+
+    void on_gravity(int i)
+    {
+        BenchGame &game = games[i];
+        counters.expired(game.gravity_due);
+
+        if (game.locking) {
+            if (random() % SlideOffOneIn == 0) {
+                // moved off the ledge, falls again
+                timers.cancel_lock(i);
+                counters.cancels++;
+                game.locking = false;
+                game.rows_left = 2;
+            }
+        } else if (--game.rows_left == 0) {
+            game.locking = true;
+            game.lock_due = SteadyClock::now() + LockDelay;
+            timers.arm_lock(i, LockDelay);
+            counters.arms++;
+        }
+        arm_gravity(i);
+    }
+
+    void on_lock(int i)
+    {
+        BenchGame &game = games[i];
+        counters.expired(game.lock_due);
+        game.locking = false;
+        game.rows_left = RowsPerPiece;
+    }
+
+private:
+    void arm_gravity(int i)
+    {
+        games[i].gravity_due = SteadyClock::now() + games[i].gravity;
+        timers.arm_gravity(i, games[i].gravity);
+        counters.arms++;
+    }
+
+    Timers &timers;
+    std::vector<BenchGame> games;
+    Counters &counters;
+    std::minstd_rand random;
+};
+
+/**
+ * Timers of every game in one wheel, ticked by one periodic event.
+ */
+class WheelTimers {
+public:
+    using Wheel = TimerWheel<MaxBenchGames * Tetris::TIMERS_PER_GAME>;
+
+    void arm_gravity(int game, std::chrono::milliseconds period)
+    {
+        wheel.arm(game * Tetris::TIMERS_PER_GAME, to_steps(period));
+    }
+
+    void arm_lock(int game, std::chrono::milliseconds delay)
+    {
+        wheel.arm(game * Tetris::TIMERS_PER_GAME + 1, to_steps(delay));
+    }
+
+    void cancel_lock(int game)
+    {
+        wheel.cancel(game * Tetris::TIMERS_PER_GAME + 1);
+    }
+
+    Wheel wheel;
+
+private:
+    static uint32_t to_steps(std::chrono::milliseconds period)
+    {
+        return period / StepPeriod;
+    }
+};
+
+/**
+ * One event queue event per armed timer.
+ */
+class EventTimers {
+public:
+    EventTimers(EventQueue &queue, int num_games)
+        : queue(queue), lock_events(num_games, 0)
+    {
+    }
+
+    void arm_gravity(int game, std::chrono::milliseconds period)
+    {
+        queue.call_in(period, [this, game] {
+            workload->on_gravity(game);
+        });
+    }
+
+    void arm_lock(int game, std::chrono::milliseconds delay)
+    {
+        lock_events[game] = queue.call_in(delay, [this, game] {
+            lock_events[game] = 0;
+            workload->on_lock(game);
+        });
+    }
+
+    void cancel_lock(int game)
+    {
+        queue.cancel(lock_events[game]);
+        lock_events[game] = 0;
+    }
+
+    Workload<EventTimers> *workload = nullptr;
+
+private:
+    EventQueue &queue;
+    std::vector<int> lock_events;
+};
+
+struct Result {
+    Counters counters;
+    uint64_t cpu_us;
+};
+
+static Result run_wheel(int num_games, int seconds)
+{
+    // large, keep it off the stack
+    static WheelTimers timers;
+    timers = WheelTimers();
+
+    Result result;
+    Workload<WheelTimers> workload(timers, num_games, result.counters);
+    EventQueue queue;
+
+    uint64_t cpu_start = thread_cpu_us();
+    workload.start();
+    queue.call_every(StepPeriod, [&workload] {
+        timers.wheel.advance([&workload](int timer) {
+            int game = timer / Tetris::TIMERS_PER_GAME;
+            if (timer % Tetris::TIMERS_PER_GAME == 0) {
+                workload.on_gravity(game);
+            } else {
+                workload.on_lock(game);
+            }
+        });
+    });
+    queue.dispatch_for(std::chrono::seconds(seconds));
+    result.cpu_us = thread_cpu_us() - cpu_start;
+    return result;
+}
+
+static Result run_events(int num_games, int seconds)
+{
+    Result result;
+    EventQueue queue;
+    EventTimers timers(queue, num_games);
+    Workload<EventTimers> workload(timers, num_games, result.counters);
+    timers.workload = &workload;
+
+    uint64_t cpu_start = thread_cpu_us();
+    workload.start();
+    queue.dispatch_for(std::chrono::seconds(seconds));
+    result.cpu_us = thread_cpu_us() - cpu_start;
+    return result;
+}
+
+static void print_result(int num_games, const char *name, const Result &result)
+{
+    const Counters &counters = result.counters;
+    printf("%6d %-7s %9u %8u %9u %9llu %9.2f %10llu %10llu\n",
+           num_games, name, counters.arms, counters.cancels, counters.expiries,
+           (unsigned long long) result.cpu_us / 1000,
+           counters.expiries ? (double) result.cpu_us / counters.expiries : 0.0,
+           (unsigned long long) (counters.expiries ? counters.lateness_total_us / counters.expiries : 0),
+           (unsigned long long) counters.lateness_max_us);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<int> game_counts;
+    int seconds = 3;
+
+    int option;
+    while ((option = getopt(argc, argv, "g:t:h")) != -1) {
+        switch (option) {
+        case 'g': game_counts.push_back(std::atoi(optarg)); break;
+        case 't': seconds = std::atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-g games]... [-t seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (game_counts.empty()) {
+        game_counts = { 100, 250, 500 };
+    }
+    for (int num_games : game_counts) {
+        if (num_games <= 0 || num_games > MaxBenchGames) {
+            fprintf(stderr, "games must be between 1 and %d\n", MaxBenchGames);
+            return 1;
+        }
+    }
+
+    printf("%d ms steps, %d s per case\n", (int) StepPeriod.count(), seconds);
+    printf("%6s %-7s %9s %8s %9s %9s %9s %10s %10s\n",
+           "games", "timers", "arms", "cancels", "expiries", "cpu ms", "us/expiry",
+           "late avg us", "late max us");
+    for (int num_games : game_counts) {
+        print_result(num_games, "wheel", run_wheel(num_games, seconds));
+        print_result(num_games, "events", run_events(num_games, seconds));
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include "udp_controller_transport.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "controller_protocol.h"
+
+static void put_u16(std::vector<uint8_t> &datagram, uint16_t value)
+{
+    datagram.push_back(value & 0xFF);
+    datagram.push_back(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+UdpControllerTransport::UdpControllerTransport(events::EventQueue &queue, uint16_t port)
+    : queue(queue),
+      port(port),
+      socket_fd(-1),
+      running(false),
+      handler(nullptr)
+{
+    dispatch_timer.start();
+}
+
+UdpControllerTransport::~UdpControllerTransport()
+{
+    stop();
+}
+
+void UdpControllerTransport::start(EventHandler *event_handler)
+{
+    handler = event_handler;
+
+    socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        printf("Error: cannot create socket: %s\r\n", strerror(errno));
+        return;
+    }
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(socket_fd, (sockaddr *) &address, sizeof(address)) < 0) {
+        printf("Error: cannot bind port %u: %s\r\n", port, strerror(errno));
+        close(socket_fd);
+        socket_fd = -1;
+        return;
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(socket_fd, (sockaddr *) &address, &length);
+    port = ntohs(address.sin_port);
+
+    running = true;
+    receiver = std::thread([this] { receive_loop(); });
+}
+
+void UdpControllerTransport::stop()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    receiver.join();
+
+    // let the virtual controllers know the console is gone
+    for (auto &pair: connection_to_peer) {
+        send_to(pair.second, { (uint8_t) UdpLinkOp::Rejected });
+    }
+    connection_to_peer.clear();
+    peer_to_connection.clear();
+
+    close(socket_fd);
+    socket_fd = -1;
+}
+
+void UdpControllerTransport::discover(ConnectionHandle connection)
+{
+    send(connection, { (uint8_t) UdpLinkOp::Discover });
+}
+
+void UdpControllerTransport::read(ConnectionHandle connection, AttributeHandle value_handle)
+{
+    std::vector<uint8_t> datagram { (uint8_t) UdpLinkOp::Read };
+    put_u16(datagram, value_handle);
+    send(connection, datagram);
+}
+
+void UdpControllerTransport::write(
+    ConnectionHandle connection, AttributeHandle value_handle,
+    const uint8_t *data, uint16_t length)
+{
+    std::vector<uint8_t> datagram { (uint8_t) UdpLinkOp::Write };
+    put_u16(datagram, value_handle);
+    datagram.insert(datagram.end(), data, data + length);
+    send(connection, datagram);
+}
+
+void UdpControllerTransport::disconnect(ConnectionHandle connection)
+{
+    auto it = connection_to_peer.find(connection);
+    if (it == connection_to_peer.end()) {
+        return;
+    }
+    send_to(it->second, { (uint8_t) UdpLinkOp::Rejected });
+    peer_to_connection.erase(peer_key(it->second));
+    connection_to_peer.erase(it);
+    // reported right away, before the handle can be given to another peer
+    handler->on_disconnected(connection);
+}
+
+void UdpControllerTransport::receive_loop()
+{
+    uint8_t buffer[512];
+
+    while (running) {
+        // wake up regularly so stop() does not wait on a silent socket
+        pollfd descriptor { socket_fd, POLLIN, 0 };
+        if (poll(&descriptor, 1, 100) <= 0) {
+            continue;
+        }
+
+        sockaddr_in peer {};
+        socklen_t peer_length = sizeof(peer);
+        ssize_t length = recvfrom(
+            socket_fd, buffer, sizeof(buffer), 0, (sockaddr *) &peer, &peer_length
+        );
+        if (length <= 0) {
+            continue;
+        }
+
+        std::vector<uint8_t> datagram(buffer, buffer + length);
+        uint64_t posted_us = dispatch_timer.elapsed_time().count();
+        queue.call([this, peer, datagram, posted_us] {
+            dispatch_latency.add((uint32_t) (dispatch_timer.elapsed_time().count() - posted_us));
+            handle_datagram(peer, datagram);
+        });
+    }
+}
+
+void UdpControllerTransport::handle_datagram(
+    const sockaddr_in &peer, const std::vector<uint8_t> &datagram)
+{
+    if (!running) {
+        return;
+    }
+
+    const uint8_t *data = datagram.data();
+    size_t length = datagram.size();
+    UdpLinkOp op = (UdpLinkOp) data[0];
+
+    auto it = peer_to_connection.find(peer_key(peer));
+    bool connected = it != peer_to_connection.end();
+
+    if (op == UdpLinkOp::Connect) {
+        if (length < 7) {
+            return;
+        }
+        if (connected) {
+            // the Connected answer was lost, repeat it
+            std::vector<uint8_t> answer { (uint8_t) UdpLinkOp::Connected };
+            put_u16(answer, it->second);
+            send_to(peer, answer);
+            return;
+        }
+        if ((int) connection_to_peer.size() >= MaxControllers) {
+            send_to(peer, { (uint8_t) UdpLinkOp::Rejected });
+            return;
+        }
+
+        // the lowest free handle, as the BLE stack hands them out
+        ConnectionHandle connection = 1;
+        while (connection_to_peer.count(connection)) {
+            connection++;
+        }
+        peer_to_connection.emplace(peer_key(peer), connection);
+        connection_to_peer.emplace(connection, peer);
+
+        std::vector<uint8_t> answer { (uint8_t) UdpLinkOp::Connected };
+        put_u16(answer, connection);
+        send_to(peer, answer);
+
+        MacAddress address;
+        std::memcpy(address.data(), data + 1, address.size());
+        handler->on_connected(connection, address);
+        return;
+    }
+
+    if (!connected) {
+        return;
+    }
+    ConnectionHandle connection = it->second;
+
+    switch (op) {
+    case UdpLinkOp::Disconnect:
+        peer_to_connection.erase(it);
+        connection_to_peer.erase(connection);
+        handler->on_disconnected(connection);
+        break;
+
+    case UdpLinkOp::Services: {
+        if (length < 2) {
+            return;
+        }
+        size_t count = data[1];
+        for (size_t i = 0; i < count && 2 + 4 * (i + 1) <= length; i++) {
+            const uint8_t *entry = data + 2 + 4 * i;
+            handler->on_characteristic_discovered(
+                connection, get_u16(entry), get_u16(entry + 2)
+            );
+        }
+        break;
+    }
+
+    case UdpLinkOp::ReadResponse:
+    case UdpLinkOp::Notify:
+        if (length < 3) {
+            return;
+        }
+        handler->on_data(connection, get_u16(data + 1), data + 3, length - 3);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void UdpControllerTransport::send_to(const sockaddr_in &peer, const std::vector<uint8_t> &datagram)
+{
+    sendto(socket_fd, datagram.data(), datagram.size(), 0, (const sockaddr *) &peer, sizeof(peer));
+}
+
+void UdpControllerTransport::send(ConnectionHandle connection, const std::vector<uint8_t> &datagram)
+{
+    auto it = connection_to_peer.find(connection);
+    if (it != connection_to_peer.end()) {
+        send_to(it->second, datagram);
+    }
+}
+
+uint64_t UdpControllerTransport::peer_key(const sockaddr_in &peer)
+{
+    return ((uint64_t) peer.sin_addr.s_addr << 16) | peer.sin_port;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "controller.h"
+#include "action_coalescer.h"
+#include "fixed_step_clock.h"
+
+#include "TetrisManager.h"
+#include "TetrisRenderer.h"
+#include "TetrisAction.h"
+
+// One step of the game loop: input is applied and gravity counted every
+// step, the boards are rendered every few steps, see mbed_app.json
+static const std::chrono::milliseconds GameStepPeriod(MBED_CONF_APP_GAME_STEP_MS);
+static const int RenderPeriodSteps =
+    MBED_CONF_APP_RENDER_PERIOD_MS / MBED_CONF_APP_GAME_STEP_MS > 0
+    ? MBED_CONF_APP_RENDER_PERIOD_MS / MBED_CONF_APP_GAME_STEP_MS : 1;
+// Steps a late frame may catch up on, beyond that they are skipped
+static const int MaxCatchUpSteps = 10;
+
+static_assert(MaxControllers <= MAX_GAMES, "every controller gets a board");
+
+/**
+ * The console game: assigns a board to every validated controller as soon
+ * as the roster changes and runs the frame loop that feeds their actions
+ * into the Tetris games.
+ *
+ * The loop runs on a fixed timestep: every frame runs the steps that fell
+ * due since the previous one, so the games advance at the same pace
+ * however late the event queue dispatches the frame. Each game falls at
+ * the rate of its own level, counted in steps by the game manager.
+ *
+ * The game only knows about a ControllerTransport, so the same loop runs
+ * over BLE on the board and over an emulated transport on a host.
+ *
+ * Controllers are handled on the transport queue and the frames run on
+ * the game queue, which may be dispatched by another thread: actions go
+ * through the lock-free controller queues and roster changes are posted
+ * across. Both can be the same queue.
+ */
+class BlockBashGame : private ControllerConnectionHandler::RosterHandler {
+public:
+    /**
+     * Load figures of the console, for instrumentation and load tests.
+     */
+    struct Stats {
+        unsigned frames = 0;
+        uint64_t frame_time_total_us = 0;
+        uint32_t frame_time_max_us = 0;
+        // gestures taken from the queues, and the game moves they made
+        unsigned actions_applied = 0;
+        unsigned moves_applied = 0;
+        unsigned frames_rendered = 0;
+        FixedStepClock::Stats clock;
+        ActionQueueStats queues;
+        // from the gesture on the controller to its action on the board
+        LatencyHistogram gesture_latency;
+        // the same, for each board
+        LatencyHistogram board_latency[MaxControllers];
+        int players = 0;
+        unsigned roster_version = 0;
+        // roster version the display has caught up with
+        unsigned roster_version_shown = 0;
+        LatencyHistogram roster_latency;
+    };
+
+    /**
+     * Figures of the controller links, written on the transport queue.
+     */
+    struct ConnectionStats {
+        ControllerConnection::ReadLatency read_latency;
+        // how long link events waited for the transport queue
+        DispatchLatency transport_dispatch;
+        unsigned duplicate_gestures = 0;
+        unsigned missed_gestures = 0;
+    };
+
+    /**
+     * @param queue the queue the transport was built with.
+     * @param game_queue runs the frames and the rendering.
+     */
+    BlockBashGame(ControllerTransport &transport, EventQueue &queue, EventQueue &game_queue);
+
+    /**
+     * Give a board to every valid controller that has none yet, until
+     * the game starts. Runs on the game queue.
+     */
+    void setup_controllers();
+
+    /**
+     * Run the game steps that are due, and render if a render is due.
+     */
+    void run_game_frame();
+
+    void start_game();
+
+    /**
+     * Start the game and, after a grace period, the frame loop. Does
+     * nothing if the game was already started, so repeated button presses
+     * can all be posted. Runs on the game queue.
+     */
+    void request_start();
+
+    /**
+     * Figures of the game, taken on the game queue.
+     */
+    Stats get_stats() const;
+
+    /**
+     * Figures of the controller links, taken on the transport queue.
+     */
+    ConnectionStats get_connection_stats() const;
+
+    /**
+     * Print the game figures, then the link figures from the transport
+     * queue. Runs on the game queue.
+     */
+    void print_stats();
+
+private:
+    void print_connection_stats();
+
+    void on_roster_changed(unsigned version) override;
+
+    void run_game_step();
+
+    void apply_input(int game);
+
+    int num_games;
+    bool started;
+    unsigned frames;
+    uint64_t frame_time_total_us;
+    uint32_t frame_time_max_us;
+    unsigned actions_applied;
+    unsigned moves_applied;
+    LatencyHistogram gesture_latency;
+    LatencyHistogram board_latency[MaxControllers];
+    LatencyHistogram roster_latency;
+    // controller id of every board, the controller entry holds the way back
+    int game_to_controller[MaxControllers];
+    // steps until the next render
+    int render_countdown;
+    FixedStepClock clock;
+    EventQueue &event_queue;
+    EventQueue &game_queue;
+    ControllerTransport &transport;
+    Tetris::TetrisRenderer renderer;
+    Tetris::TetrisGameManager game_manager;
+    ControllerSet controller_set;
+    ControllerConnectionHandler connection_manager;
+};
@@ -4,6 +4,7 @@ namespace Tetris {
         MoveLeft,
         MoveRight,
         Drop,
+        SoftDrop,
         Store,
         Rotate,
     };
@@ -15,6 +15,8 @@
 // Define the size of the game board
 constexpr int WIDTH = 10;
 constexpr int HEIGHT = 20;
+// Cleared lines per level, pieces fall faster at every level
+constexpr int LINES_PER_LEVEL = 10;
 
 using namespace Tetris;
 
@@ -87,19 +89,31 @@ namespace Tetris {
         static FallingPiece rotatePiece(const FallingPiece& piece);
 
         /**
-         * Move the current piece down by one block
+         * How far the current piece can move in a direction, in one sweep
+         * over its blocks instead of one collision check per step
          * 
-         * @return The new position of the piece
+         * @param dx, dy The direction, one of them -1 or 1
+         * @param limit The furthest distance of interest
+         * @return The number of free steps, at most limit
         */
-        FallingPiece shiftDownOne();
+        int freeDistance(int dx, int dy, int limit) const;
 
         /**
-         * Move the current piece down by one block.
-         * If the piece cannot move down, place it and spawn next.
+         * Move the current piece down as far as it can go, up to the given
+         * number of rows, in one sweep. A piece that lands stays where it
+         * is, for lock() to place.
+         * 
+         * @return The number of rows moved
+        */
+        int moveDown(int rows);
+
+        /**
+         * Move the current piece down by the given number of rows.
+         * If the piece lands on the way, place it and spawn next.
          * 
          * @return true if the piece was moved, false if placed
         */
-        bool moveDownOneChecked();
+        bool moveDownChecked(int rows);
 
         /**
          * Spawns a new piece at the top of the board
@@ -117,18 +131,12 @@ namespace Tetris {
         void removeRows(const std::set<int>& rowNums);
 
         /**
-         * Move the current piece left by one block
-         * 
-         * @return True if the piece was moved, false otherwise
-        */
-        bool moveLeft();
-
-        /**
-         * Move the current piece right by one block
+         * Move the current piece sideways, as far as it can go up to the
+         * given number of columns: negative to the left, positive to the right
          * 
          * @return True if the piece was moved, false otherwise
         */
-        bool moveRight();
+        bool moveHorizontal(int columns);
 
         /**
          * Rotate the current piece
@@ -166,12 +174,30 @@ namespace Tetris {
 
         void start();
 
-        void applyAction(TetrisAction action);
+        /**
+         * Apply a player action count times: moves go count columns, soft
+         * drops count rows and rotations count quarter turns. A drop or a
+         * store happens once. A soft drop leaves a landed piece for lock().
+        */
+        void applyAction(TetrisAction action, int count = 1);
+
+        /**
+         * Let the current piece fall by a row if it can. A piece that
+         * cannot fall is left for lock() to place.
+         * 
+         * @return True if the piece fell
+        */
+        bool fall();
+
+        /**
+         * True if the current piece lies on the stack or the floor
+        */
+        bool isResting() const;
 
         /**
-         * Run a single tick of the game
+         * Place the current piece where it rests and spawn the next one
         */
-        void tick();
+        void lock();
 
 
         /**
@@ -194,10 +220,44 @@ namespace Tetris {
         */
         int getScore() const;
 
+        /**
+         * Returns the current level, from the cleared lines
+        */
+        int getLevel() const;
+
         /**
          * Returns the current game state
         */
         TetrisGameState getState() const;
     };
 
+
+    /**
+     * A view of games stored next to each other, without owning them
+    */
+    class GameSpan {
+    private:
+        TetrisGame* first;
+        size_t count;
+
+    public:
+        GameSpan(TetrisGame* first, size_t count) : first(first), count(count) {}
+
+        TetrisGame* begin() const {
+            return first;
+        }
+
+        TetrisGame* end() const {
+            return first + count;
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        TetrisGame& operator[](size_t index) const {
+            return first[index];
+        }
+    };
+
 };
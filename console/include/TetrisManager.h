@@ -3,43 +3,135 @@
 #include "TetrisAction.h"
 #include "TetrisGame.h"
 #include "TetrisRenderer.h"
+#include "timer_wheel.h"
 
 #include <iostream>
 #include <array>
 #include <vector>
 #include <utility> // for std::pair
 #include <algorithm> // for std::min_element
+#include <chrono>
 
 // #define NUM_GAMES 3
 #define TICKS_PER_SECOND 3
+// Time a landed piece can still be moved before it is placed
+#define LOCK_DELAY_MS 500
+
+// Games a manager can run at once
+constexpr int MAX_GAMES = 8;
 
 namespace Tetris {
+    /**
+     * Timers every game has in the manager timer wheel
+     */
+    enum class GameTimer {
+        Gravity = 0,
+        LockDelay = 1,
+    };
+
+    constexpr int TIMERS_PER_GAME = 2;
+
     class TetrisGameManager {
     private:
-        std::vector<TetrisGame*> games {};
+        // Games live next to each other in the manager, constructed in
+        // place as they are added
+        alignas(TetrisGame) unsigned char gameStorage[MAX_GAMES * sizeof(TetrisGame)];
+
+        int numGames {0};
+
+        TetrisGame* gameData() {
+            return reinterpret_cast<TetrisGame*>(gameStorage);
+        }
+
+        const TetrisGame* gameData() const {
+            return reinterpret_cast<const TetrisGame*>(gameStorage);
+        }
 
         TetrisRenderer renderer;
 
         bool running {false};
 
+        // Length of a step, the tick of the timer wheel
+        std::chrono::milliseconds stepPeriod;
+
+        TimerWheel<MAX_GAMES * TIMERS_PER_GAME> timers;
+
+        static int timerId(int gameIndex, GameTimer timer) {
+            return gameIndex * TIMERS_PER_GAME + static_cast<int>(timer);
+        }
+
+        uint32_t toSteps(std::chrono::milliseconds period) const;
+
+        /**
+         * Arm the gravity timer of a game for the period of its level
+        */
+        void armGravity(int gameIndex);
+
+        /**
+         * Start the lock delay when the piece of a game has landed, and
+         * stop it when the piece is free to fall again
+        */
+        void updateLockDelay(int gameIndex);
+
+        void onTimer(int timer);
+
     public:
-        TetrisGameManager(const TetrisRenderer& renderer) : renderer(renderer) {}
+        TetrisGameManager(const TetrisRenderer& renderer, std::chrono::milliseconds stepPeriod)
+            : renderer(renderer), stepPeriod(stepPeriod) {}
 
         ~TetrisGameManager() {
-            for (auto& game : games) {
-                delete game;
+            for (auto& game : getGames()) {
+                game.~TetrisGame();
             }
         }
 
+        TetrisGameManager(const TetrisGameManager&) = delete;
+        TetrisGameManager& operator=(const TetrisGameManager&) = delete;
+
+        /**
+         * The games added so far, in order
+        */
+        GameSpan getGames() {
+            return GameSpan(gameData(), numGames);
+        }
+
         void playGame();
 
+        /**
+         * Add a game, up to MAX_GAMES
+         * 
+         * @return The index of the game, -1 if there is no room left
+        */
         int addGame();
 
-        void pushAction(int gameIndex, TetrisAction action);
+        void pushAction(int gameIndex, TetrisAction action, int count = 1);
 
         void renderGames();
 
-        void runTick();
+        /**
+         * Advance every game by one step: pieces fall when their gravity
+         * timer expires and are placed when their lock delay does.
+         * Rendering is left to the caller, which renders at its own rate.
+         */
+        void runStep();
+
+        /**
+         * Time between two ticks of a game at its current level, starting
+         * at TICKS_PER_SECOND and getting faster with every level.
+         */
+        std::chrono::milliseconds getGravityPeriod(int gameIndex) const;
+
+        unsigned getFramesRendered() const {
+            return renderer.getFramesRendered();
+        }
+
+        void setRosterVersion(unsigned version) {
+            renderer.setRosterVersion(version);
+        }
+
+        unsigned getRosterVersion() const {
+            return renderer.getRosterVersion();
+        }
     };
 
 }
\ No newline at end of file
@@ -8,7 +8,10 @@ namespace Tetris {
 
     class TetrisRenderer {
     private:
-        void renderGame(const TetrisGame* game);
+        unsigned framesRendered {0};
+        unsigned rosterVersion {0};
+
+        void renderGame(const TetrisGame& game);
 
         static std::ostream& get_render_stream() {
             std::cout << "RENDER ";
@@ -20,8 +23,26 @@ namespace Tetris {
             get_render_stream() << "0 " + std::to_string(width) + " " + std::to_string(height) << std::endl;
         }
 
-        void renderGames(const std::vector<TetrisGame*> games);
+        void renderGames(GameSpan games);
 
         void setGames(int numgames);
+
+        /**
+         * Returns the number of frames sent to the display so far
+        */
+        unsigned getFramesRendered() const {
+            return framesRendered;
+        }
+
+        /**
+         * Records the version of the player roster the boards now show
+        */
+        void setRosterVersion(unsigned version) {
+            rosterVersion = version;
+        }
+
+        unsigned getRosterVersion() const {
+            return rosterVersion;
+        }
     };
 }
@@ -0,0 +1,175 @@
+#ifndef ACTION_COALESCER_H_
+#define ACTION_COALESCER_H_
+
+#include <cstdint>
+
+#include "controller.h"
+
+// Gestures a player can get applied in one frame, the rest wait for the
+// next frames so a flood from one controller cannot stall the others
+static const int InputBudgetPerFrame = 8;
+
+/**
+ * An action repeated count times.
+ */
+struct CoalescedAction {
+    Action action;
+    int count;
+};
+
+/**
+ * Folds the actions a player queued since the last frame into as few game
+ * moves as possible, in order:
+ *
+ * - consecutive moves the same way add up, three Left become Left x3; a
+ *   Left then a Right stay two steps, as a move blocked by a wall must not
+ *   cancel the one after it; a move counts as many columns as its
+ *   magnitude;
+ * - consecutive rotations count modulo 4, four of them do nothing; a
+ *   rotation counts as many quarter turns as its magnitude;
+ * - consecutive soft drops add up, a soft drop counts as many rows as its
+ *   magnitude;
+ * - a Drop ends the input of the frame, later actions are left for the
+ *   next frames and the next piece.
+ *
+ * Holds at most InputBudgetPerFrame moves, without allocating.
+ */
+class ActionCoalescer {
+public:
+    /**
+     * Fold the next action in. The magnitude is the number of columns of a
+     * move, of rows of a soft drop or of quarter turns of a rotation, 0 from
+     * controllers that do not report one counts as 1.
+     *
+     * @return false if the action was discarded because a Drop came
+     * before it, or the coalescer is full.
+     */
+    bool add(Action action, uint8_t magnitude = 1)
+    {
+        if (dropped || num_steps == InputBudgetPerFrame) {
+            return false;
+        }
+
+        int amount = magnitude ? magnitude : 1;
+
+        switch (action) {
+        case Action::Left:
+            fold(Kind::Horizontal, -amount);
+            break;
+
+        case Action::Right:
+            fold(Kind::Horizontal, amount);
+            break;
+
+        case Action::FlipRight:
+            // quarter turns, a whole turn leaves the piece as it is
+            if (amount % 4 != 0) {
+                fold(Kind::Rotation, amount % 4);
+            }
+            break;
+
+        case Action::FlipLeft:
+            if (amount % 4 != 0) {
+                fold(Kind::Rotation, 4 - amount % 4);
+            }
+            break;
+
+        case Action::SoftDrop:
+            fold(Kind::SoftDrop, amount);
+            break;
+
+        case Action::Save:
+            // storing twice in a row swaps nothing more
+            if (num_steps == 0 || steps[num_steps - 1].kind != Kind::Store) {
+                steps[num_steps++] = {Kind::Store, 1};
+            }
+            break;
+
+        case Action::Down:
+            steps[num_steps++] = {Kind::Drop, 1};
+            dropped = true;
+            break;
+
+        default:
+            // pauses are not handled by the games
+            break;
+        }
+        return true;
+    }
+
+    /**
+     * True once a Drop has been folded in, nothing else is taken after it.
+     */
+    bool has_dropped() const
+    {
+        return dropped;
+    }
+
+    int size() const
+    {
+        return num_steps;
+    }
+
+    /**
+     * The i-th move to apply, from the first to the last.
+     */
+    CoalescedAction get(int i) const
+    {
+        const Step &step = steps[i];
+        switch (step.kind) {
+        case Kind::Horizontal:
+            return step.amount < 0
+                ? CoalescedAction{Action::Left, -step.amount}
+                : CoalescedAction{Action::Right, step.amount};
+
+        case Kind::Rotation:
+            return CoalescedAction{Action::FlipRight, step.amount};
+
+        case Kind::SoftDrop:
+            return CoalescedAction{Action::SoftDrop, step.amount};
+
+        case Kind::Store:
+            return CoalescedAction{Action::Save, 1};
+
+        case Kind::Drop:
+        default:
+            return CoalescedAction{Action::Down, 1};
+        }
+    }
+
+private:
+    enum class Kind : uint8_t { Horizontal, Rotation, SoftDrop, Store, Drop };
+
+    struct Step {
+        Kind kind;
+        int amount;
+    };
+
+    /**
+     * Add amount to the last step if it is of the same kind, and for moves
+     * the same way, dropping the step when it comes to nothing so that its
+     * neighbours can merge.
+     */
+    void fold(Kind kind, int amount)
+    {
+        if (num_steps > 0 && steps[num_steps - 1].kind == kind &&
+            (kind != Kind::Horizontal || (steps[num_steps - 1].amount < 0) == (amount < 0))) {
+            Step &last = steps[num_steps - 1];
+            last.amount += amount;
+            if (kind == Kind::Rotation) {
+                last.amount %= 4;
+            }
+            if (last.amount == 0) {
+                num_steps--;
+            }
+        } else {
+            steps[num_steps++] = {kind, amount};
+        }
+    }
+
+    Step steps[InputBudgetPerFrame];
+    int num_steps = 0;
+    bool dropped = false;
+};
+
+#endif /* ACTION_COALESCER_H_ */
@@ -0,0 +1,439 @@
+#ifndef BLE_CONTROLLER_TRANSPORT_H_
+#define BLE_CONTROLLER_TRANSPORT_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "mbed.h"
+#include "ble/BLE.h"
+
+#include <events/mbed_events.h>
+
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+
+#include "Gap.h"
+#include "gap/AdvertisingDataParser.h"
+#include "ble/common/FunctionPointerWithContext.h"
+
+#include "pretty_printer.h"
+#include "controller_protocol.h"
+#include "controller_transport.h"
+
+static const uint16_t MaxAdvPayloadSize = 50;
+
+// Every controller link gets the same connection interval, with room for
+// one connection event slot per possible controller, so the link layer
+// can interleave all anchors and per-player latency does not depend on
+// how many players are connected.
+static const uint16_t ConnectionEventSlotUnits = 3;   // 1.25ms units
+static const uint16_t MinConnectionIntervalUnits = 6; // 7.5ms, the BLE minimum
+static const uint16_t ConnectionIntervalUnits =
+    (MaxControllers * ConnectionEventSlotUnits < MinConnectionIntervalUnits)
+        ? MinConnectionIntervalUnits
+        : MaxControllers * ConnectionEventSlotUnits;
+
+/**
+ * Controller transport over the mbed BLE stack.
+ *
+ * The console alternates between scanning for controllers and advertising
+ * itself, connects to every device named "BlockBashController" and runs
+ * GATT discovery, reads and writes on the connections.
+ */
+class BleControllerTransport
+    : private mbed::NonCopyable<BleControllerTransport>,
+      public ControllerTransport,
+      public ble::Gap::EventHandler
+{
+    using AdvertisingHandle = ble::advertising_handle_t;
+
+protected:
+    events::EventQueue &queue;
+    BLE &ble;
+    ble::Gap &gap;
+    ble::GattClient &gatt;
+    ControllerTransport::EventHandler *handler = nullptr;
+
+    int num_links = 0;
+
+    uint8_t advertising_buff[MaxAdvPayloadSize];
+    ble::AdvertisingDataBuilder data_builder;
+
+    AdvertisingHandle advertising_handle = ble::LEGACY_ADVERTISING_HANDLE;
+
+    bool is_connecting = false;
+
+    // free running, stamps stack events when they are handed over
+    mbed::Timer dispatch_timer;
+    DispatchLatency dispatch_latency;
+public:
+    /**
+     * Construct a BLEProcess from an event queue and a ble interface.
+     * Call start() to initiate ble processing.
+     */
+    BleControllerTransport(events::EventQueue &event_queue, BLE &ble_interface) :
+        queue(event_queue),
+        ble(ble_interface),
+        gap(ble_interface.gap()),
+        gatt(ble_interface.gattClient()),
+        data_builder(advertising_buff)
+    {
+        dispatch_timer.start();
+    }
+
+    ~BleControllerTransport()
+    {
+        stop();
+    }
+
+    void start(ControllerTransport::EventHandler *event_handler) override
+    {
+        handler = event_handler;
+
+        if (ble.hasInitialized()) {
+            printf("Error: the ble instance has already been initialized.\r\n");
+            return;
+        }
+
+        /* handle gap events */
+        gap.setEventHandler(this);
+
+        /* This will inform us off all events so we can schedule their handling
+         * using our event queue */
+        ble.onEventsToProcess(
+            makeFunctionPointer(this,
+                &BleControllerTransport::schedule_ble_events)
+        );
+
+        ble_error_t error = ble.init(
+            this, &BleControllerTransport::on_init_complete
+        );
+
+        if (error) {
+            print_error(error, "Error returned by BLE::init.\r\n");
+            return;
+        }
+
+        return;
+    }
+
+    void stop() override
+    {
+        if (ble.hasInitialized()) {
+            ble.shutdown();
+            // printf("Controller Handler has stopped.\r\n");
+        }
+    }
+
+    void discover(ConnectionHandle connection) override
+    {
+        ServiceDiscovery::TerminationCallback_t termination_callback;
+        ServiceDiscovery::ServiceCallback_t service_callback;
+        ServiceDiscovery::CharacteristicCallback_t characteristic_callback;
+
+        termination_callback.attach(this, &BleControllerTransport::discovery_termination);
+        service_callback.attach(this, &BleControllerTransport::service_discovery);
+        characteristic_callback.attach(this, &BleControllerTransport::characteristic_discovery);
+
+        this->gatt.onServiceDiscoveryTermination(termination_callback);
+        this->gatt.launchServiceDiscovery(
+            connection,
+            service_callback,
+            characteristic_callback,
+            ControllerServiceUUID
+        );
+    }
+
+    void read(ConnectionHandle connection, AttributeHandle value_handle) override
+    {
+        this->gatt.read(connection, value_handle, 0);
+    }
+
+    void write(
+        ConnectionHandle connection, AttributeHandle value_handle,
+        const uint8_t *data, uint16_t length) override
+    {
+        this->gatt.write(
+            ble::GattClient::GATT_OP_WRITE_REQ, connection, value_handle, length, data
+        );
+    }
+
+    void disconnect(ConnectionHandle connection) override
+    {
+        this->gap.disconnect(connection, ble::local_disconnection_reason_t::USER_TERMINATION);
+    }
+
+    const char* name()
+    {
+        static const char name[] = "BlockBashConsole";
+        return name;
+    }
+
+    const char* controller_name()
+    {
+        static const char name[] = "BlockBashController";
+        return name;
+    }
+
+protected:
+    void on_init_complete(BLE::InitializationCompleteCallbackContext *event)
+    {
+        if (event->error) {
+            print_error(event->error, "Error during the initialisation\r\n");
+            return;
+        }
+
+        // printf("Ble instance initialized\r\n");
+
+        /* All calls are serialised on the user thread through the event queue */
+        start_activity();
+
+        this->start_gatt();
+    }
+
+    void onScanTimeout(const ble::ScanTimeoutEvent &event) override {
+        start_activity();
+    }
+
+    void onConnectionComplete(const ble::ConnectionCompleteEvent &event) override
+    {
+        if (event.getStatus() == BLE_ERROR_NONE) {
+            // printf("\r\nConnected to: \r\n");
+
+            const ble::address_t &peer = event.getPeerAddress();
+            // print_address(peer);
+
+            MacAddress addr;
+            std::memcpy(addr.data(), peer.data(), addr.size());
+
+            num_links++;
+            handler->on_connected(event.getConnectionHandle(), addr);
+
+            this->start_activity();
+        } else {
+            // printf("Failed to connect\r\n");
+            start_activity();
+        }
+    }
+
+    void onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event) override
+    {
+        num_links--;
+        handler->on_disconnected(event.getConnectionHandle());
+        start_activity();
+    }
+
+    void onAdvertisingEnd(const ble::AdvertisingEndEvent &event) override
+    {
+        start_activity();
+    }
+
+    void onAdvertisingReport(const ble::AdvertisingReportEvent &event) override {
+        /* don't bother with analysing scan result if we're already connecting */
+        // printf("Is connecting %d\n", is_connecting);
+        if (is_connecting) {
+            return;
+        }
+
+        /* the BLE stack cannot take another link */
+        if (num_links >= MaxControllers) {
+            return;
+        }
+
+        ble::AdvertisingDataParser adv_data(event.getPayload());
+
+        /* parse the advertising payload, looking for a discoverable device */
+        while (adv_data.hasNext()) {
+            ble::AdvertisingDataParser::element_t field = adv_data.next();
+
+            /* connect to a discoverable device */
+            if (field.type == ble::adv_data_type_t::COMPLETE_LOCAL_NAME) {
+                //printf("Found a: %s\r\n", field.value.data());
+                if (field.value.size() == strlen(controller_name()) &&
+                    (memcmp(field.value.data(), controller_name(), field.value.size()) == 0)) {
+
+                    // printf("We found \"%s\", connecting...\r\n", controller_name());
+
+                    ble_error_t error = ble.gap().stopScan();
+
+                    if (error) {
+                        print_error(error, "Error caused by Gap::stopScan");
+                        return;
+                    }
+
+                    ble::ConnectionParameters connection_params;
+                    connection_params.setConnectionParameters(
+                        ble::conn_interval_t(ConnectionIntervalUnits),
+                        ble::conn_interval_t(ConnectionIntervalUnits),
+                        ble::slave_latency_t(0),
+                        ble::supervision_timeout_t(ble::millisecond_t(4000)),
+                        ble::phy_t::LE_1M,
+                        // event lengths are in 0.625ms units
+                        ble::conn_event_length_t(ConnectionEventSlotUnits * 2),
+                        ble::conn_event_length_t(ConnectionEventSlotUnits * 2)
+                    );
+
+                    error = ble.gap().connect(
+                        event.getPeerAddressType(),
+                        event.getPeerAddress(),
+                        connection_params
+                    );
+
+                    if (error) {
+                        gap.startScan();
+                        return;
+                    }
+
+                    /* we may have already scan events waiting
+                     * to be processed so we need to remember
+                     * that we are already connecting and ignore them */
+                    is_connecting = true;
+
+                    return;
+                }
+            }
+        }
+    }
+
+    void start_activity()
+    {
+        // start scanning only once
+        static bool scan = true;
+        // static bool scan = false;
+        if (scan) {
+            queue.call([this]() { start_scanning(); });
+        } else {
+            queue.call([this]() { start_advertising(); });
+        }
+        scan = !scan;
+        // scan = true;
+        is_connecting = false;
+    }
+
+    void start_scanning()
+    {
+        ble::ScanParameters scan_params;
+        gap.setScanParameters(scan_params);
+        ble_error_t ret = gap.startScan(ble::scan_duration_t(ble::millisecond_t(5000)));
+        if (ret == ble_error_t::BLE_ERROR_NONE) {
+            // printf("Started scanning for \"%s\"\r\n", controller_name());
+        } else {
+            // printf("Starting scan failed\r\n");
+        }
+    }
+
+    void start_advertising()
+    {
+        ble_error_t error;
+
+        if (gap.isAdvertisingActive(advertising_handle)) {
+            /* we're already advertising */
+            return;
+        }
+
+        ble::AdvertisingParameters adv_params(
+            ble::advertising_type_t::CONNECTABLE_UNDIRECTED,
+            ble::adv_interval_t(ble::millisecond_t(40))
+        );
+
+        error = gap.setAdvertisingParameters(advertising_handle, adv_params);
+
+        if (error) {
+            print_error(error, "");
+            printf("_ble.gap().setAdvertisingParameters() failed\r\n");
+            return;
+        }
+
+        data_builder.clear();
+        data_builder.setFlags();
+        data_builder.setName(name());
+
+        /* Set payload for the set */
+        error = gap.setAdvertisingPayload(
+            advertising_handle, data_builder.getAdvertisingData()
+        );
+
+        if (error) {
+            print_error(error, "Gap::setAdvertisingPayload() failed\r\n");
+            return;
+        }
+
+        error = gap.startAdvertising(advertising_handle, ble::adv_duration_t(ble::millisecond_t(4000)));
+
+        if (error) {
+            print_error(error, "Gap::startAdvertising() failed\r\n");
+            return;
+        }
+
+        // printf("Advertising as \"%s\"\r\n", name());
+    }
+
+    void schedule_ble_events(BLE::OnEventsToProcessCallbackContext *event)
+    {
+        uint64_t posted_us = dispatch_timer.elapsed_time().count();
+        BLE *stack = &event->ble;
+        queue.call([this, stack, posted_us] {
+            dispatch_latency.add((uint32_t) (dispatch_timer.elapsed_time().count() - posted_us));
+            stack->processEvents();
+        });
+    }
+
+    void on_write(const GattWriteCallbackParams *response)
+    {
+        // printf(" signal delivered! \r\n");
+    }
+
+    void on_read(const GattReadCallbackParams *response)
+    {
+        handler->on_data(
+            response->connHandle,
+            response->handle,
+            response->data + response->offset,
+            response->len
+        );
+    }
+
+    void on_notification(const GattHVXCallbackParams *params)
+    {
+        handler->on_data(params->connHandle, params->handle, params->data, params->len);
+    }
+
+    void start_gatt() {
+        ble::WriteCallback_t write_callback;
+        ble::ReadCallback_t read_callback;
+        ble::HVXCallback_t notification_callback;
+
+        write_callback.attach(this, &BleControllerTransport::on_write);
+        read_callback.attach(this, &BleControllerTransport::on_read);
+        notification_callback.attach(this, &BleControllerTransport::on_notification);
+
+        this->gatt.onDataRead(read_callback);
+        this->gatt.onDataWritten(write_callback);
+        this->gatt.onHVX(notification_callback);
+    }
+
+    void discovery_termination(ble::connection_handle_t connectionHandle)
+    {
+    }
+
+    void characteristic_discovery(const DiscoveredCharacteristic *characteristic)
+    {
+        // printf("%x\r\n", characteristic->getUUID().getShortUUID());
+        handler->on_characteristic_discovered(
+            characteristic->getConnectionHandle(),
+            characteristic->getUUID().getShortUUID(),
+            characteristic->getValueHandle()
+        );
+    }
+
+    void service_discovery(const DiscoveredService *service)
+    {
+        if (service->getUUID().shortOrLong() == UUID::UUID_TYPE_SHORT) {
+            if (service->getUUID().getShortUUID() == ControllerServiceUUID) {
+                // printf("Controller Service Found!\r\n");
+            }
+        }
+    }
+};
+
+#endif /* BLE_CONTROLLER_TRANSPORT_H_ */
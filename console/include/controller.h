@@ -1,37 +1,27 @@
+#ifndef CONTROLLER_H_
+#define CONTROLLER_H_
+
+#include <atomic>
 #include <cstdint>
-#include <unordered_map>
-#include <map>
-#include <utility>
+#include <cstring>
 #include <iostream>
-#include <deque>
-#include <vector>
 
 #include "mbed.h"
-#include "ble/BLE.h"
 
 #include <events/mbed_events.h>
 
-#include "platform/Callback.h"
 #include "platform/NonCopyable.h"
 
-#include "Gap.h"
-#include "gap/AdvertisingDataParser.h"
-#include "ble/common/FunctionPointerWithContext.h"
-
-#include "pretty_printer.h"
-
-static DiscoveredCharacteristic gesture_characteristic;
-static bool gesture_characteristic_found = false;
-
-const static uint16_t ControllerServiceUUID = 0xA000;
-const static uint16_t GestureCharacteristicUUID = 0xA001;
-const static uint16_t SignalCharacteristicUUID = 0xA002;
-
-static const uint16_t MaxAdvPayloadSize = 50;
+#include "controller_protocol.h"
+#include "controller_transport.h"
+#include "event_tracker.h"
+#include "latency_histogram.h"
+#include "spsc_ring.h"
 
 // Enum representing actions
 enum class Action { 
     Down, 
+    SoftDrop,
     Left, 
     Right, 
     Save, 
@@ -41,13 +31,7 @@ enum class Action {
     NoOp 
 };
 
-enum class ControllerSignal : uint8_t {
-    PlayerId  = 0x15,
-    ReadyState   = 0x20,
-    PausedState  = 0x40
-};
-
-Action parse_action(uint8_t num)
+inline Action parse_action(uint8_t num)
 {
     switch (num) {
     case 0x01:
@@ -65,667 +49,972 @@ Action parse_action(uint8_t num)
     case 0x05:
         return Action::FlipRight;
 
+    case 0x06:
+        return Action::SoftDrop;
+
     default:
         return Action::NoOp;
     }
 }
 
-class Controller {
-private:
-    bool connected;
-    bool valid;
-    int id;
-    std::deque<std::pair<Action, uint8_t>> action_queue;
+/**
+ * Milliseconds on the console clock, the time base of gesture timestamps
+ * once they have been received.
+ */
+inline uint32_t console_time_ms()
+{
+    return (uint32_t) Kernel::Clock::now().time_since_epoch().count();
+}
+
+/**
+ * A gesture waiting in a controller queue.
+ */
+struct ControllerAction {
+    Action action;
+    uint8_t magnitude;
+    // when the gesture was made, on the console clock
+    uint32_t gesture_ms;
+};
 
+// Actions a controller can have waiting; a full queue drops its oldest
+// action. Must be a power of two.
+static const size_t ActionQueueCapacity = 16;
+
+// Controllers the console remembers, connected or not. Controller ids run
+// from 1 to MaxKnownControllers and index the ControllerSet table; once it
+// is full, a new controller takes the id of a disconnected one without a
+// board.
+static const int MaxKnownControllers = 2 * MaxControllers;
+static_assert(MaxKnownControllers <= 32, "controller masks are 32 bit");
+
+/**
+ * Entry of the controller table: who a controller is, where to reach it
+ * and the actions it has waiting.
+ *
+ * Attribute handles are 0 until discovered; 0 is never a valid ATT handle.
+ */
+class Controller : private mbed::NonCopyable<Controller> {
 public:
+    using ConnectionHandle = ControllerTransport::ConnectionHandle;
+    using AttributeHandle = ControllerTransport::AttributeHandle;
+    using MacAddress = ControllerTransport::MacAddress;
 
-    Controller(int id) 
-        : connected(true), id(id), valid(false)
-    {}
+    MacAddress mac {};
+    ConnectionHandle connection = 0;
+    AttributeHandle gesture_handle = 0;
+    AttributeHandle signal_handle = 0;
+    static const int NoGame = -1;
+    // the id is being handed to another controller
+    static const int Reclaimed = -2;
 
-    bool is_connected() const 
-    {
-        return connected;
-    }
+    // board of the controller, NoGame until it gets one; claimed with a
+    // compare and swap by the game thread and the connection handler
+    std::atomic<int> game { NoGame };
+    // console time the controller was validated, for roster latency
+    uint32_t validated_ms = 0;
 
-    bool is_valid() const
+    void enqueue_action(const ControllerAction &action)
     {
-        return valid;
-    }
-
-    int get_id() const 
-    {
-        return id;
+        this->action_queue.push(action);
     }
 
-    void set_connection_status(bool connected)
+    /**
+     * Take the oldest queued action.
+     *
+     * @return false if the queue is empty.
+     */
+    bool dequeue_action(ControllerAction &action)
     {
-        this->connected = connected;
+        return action_queue.pop(action);
     }
 
-    void set_as_valid()
+    size_t queue_depth() const
     {
-        this->valid = true;
+        return action_queue.size();
     }
 
-    void enqueue_action(Action action, uint8_t magnitude)
+    unsigned dropped_actions() const
     {
-        this->action_queue.emplace_front(action, magnitude);
+        return action_queue.get_dropped();
     }
 
-    std::pair<Action, uint8_t> dequeue_action()
+    /**
+     * Drop the queued actions, from the producer side while no game takes
+     * them.
+     */
+    void clear_actions()
     {
-        if (!action_queue.empty()) {
-            auto first_action = action_queue.front();
-            action_queue.pop_front();
-            return first_action;
-        } else {
-            // std::cout << "Action queue is empty!" << std::endl;
-            return std::make_pair(Action::NoOp, 0); // Default action when the queue is empty
+        ControllerAction action;
+        while (action_queue.pop(action)) {
         }
     }
+
+private:
+    // filled by the connection handler, drained by the game frames
+    SpscRing<ControllerAction, ActionQueueCapacity> action_queue;
 };
 
+/**
+ * Snapshot of the action queues of a ControllerSet.
+ */
+struct ActionQueueStats {
+    unsigned enqueued = 0;
+    unsigned dropped = 0;
+    size_t queued_total = 0;
+    size_t queued_max = 0;
+};
+
+/**
+ * Every controller the console knows, in a table indexed by controller id.
+ *
+ * Connection and validity are kept as bit masks over the ids, so finding
+ * the valid controllers is a walk over set bits. Nothing is allocated once
+ * the set is built.
+ *
+ * The set is changed by the connection handler only. The game reads the
+ * valid mask, the roster version and the action queues from its own
+ * thread, so those are atomic; an entry is filled in before its valid bit
+ * is published.
+ */
 class ControllerSet {
-private:
-    std::unordered_map<int, Controller> controllers;
+public:
+    using ConnectionHandle = ControllerTransport::ConnectionHandle;
+    using MacAddress = ControllerTransport::MacAddress;
 
-    Controller* find_controller(int id)
+    static uint32_t id_bit(int id)
     {
-        auto it = controllers.find(id);
-        if (it != controllers.end()) {
-            return &it->second;
-        } else {
-            return nullptr;
-        }
+        return 1u << (id - 1);
     }
-public:
-    void make_controller(int id)
+
+    /**
+     * Id of the controller with this mac address, 0 if unknown.
+     */
+    int find_controller(const MacAddress &mac) const
     {
-        Controller new_controller(id);
-        controllers.emplace(id, new_controller);
+        for (int id = 1; id <= num_controllers; id++) {
+            if (controllers[id - 1].mac == mac) {
+                return id;
+            }
+        }
+        return 0;
     }
 
-    void queue_to_controller(int id, Action action, uint8_t magnitude)
+    /**
+     * Remember a new controller, in the id of a disconnected controller
+     * without a board once the table is full.
+     *
+     * @return its id, 0 if every known controller is connected or playing.
+     */
+    int make_controller(const MacAddress &mac)
     {
-        Controller* controller = find_controller(id);
-        if (controller) {
-            controller->enqueue_action(action, magnitude);
-        } else {
-            // std::cout << "Player with ID " << id << " not found!" << std::endl;
+        int id = num_controllers + 1;
+        if (id > MaxKnownControllers) {
+            id = reclaim_controller();
+            if (id == 0) {
+                return 0;
+            }
+            controllers[id - 1].mac = mac;
+            return id;
         }
+        controllers[id - 1].mac = mac;
+        num_controllers = id;
+        return id;
     }
 
-    std::pair<Action, uint8_t> dequeue_from_controller(int controller_id)
+    /**
+     * Give a valid controller a board, from the game thread.
+     *
+     * @return false if it already has one or its id is being reused.
+     */
+    bool assign_game(int controller_id, int game)
     {
-        Controller* controller = find_controller(controller_id);
-        return controller->dequeue_action();
+        int no_game = Controller::NoGame;
+        return controllers[controller_id - 1].game.compare_exchange_strong(no_game, game);
     }
 
-    void disconnect_controller(int controller_id)
+    Controller &get_controller(int id)
     {
-        Controller* controller = find_controller(controller_id);
-        controller->set_connection_status(false);
+        return controllers[id - 1];
     }
 
-    void reconnect_controller(int controller_id)
+    const Controller &get_controller(int id) const
     {
-        Controller* controller = find_controller(controller_id);
-        controller->set_connection_status(true);
+        return controllers[id - 1];
     }
 
-    bool is_controller_connected(int controller_id)
+    void queue_to_controller(int id, const ControllerAction &action)
     {
-        Controller* controller = find_controller(controller_id);
-        return controller->is_connected();
+        controllers[id - 1].enqueue_action(action);
+        actions_enqueued++;
     }
 
-    void validate_controller(int controller_id)
+    bool dequeue_from_controller(int controller_id, ControllerAction &action)
     {
-        Controller* controller = find_controller(controller_id);
-        controller->set_as_valid();
+        return controllers[controller_id - 1].dequeue_action(action);
     }
 
-    std::vector<int> get_valid_controllers()
+    void disconnect_controller(int controller_id)
     {
-        std::vector<int> valid_controllers;
-
-        for (auto pair: controllers) {
-            if (pair.second.is_valid()) {
-                valid_controllers.push_back(pair.first);
-            }
-        }
-
-        return valid_controllers;
+        connected_mask &= ~id_bit(controller_id);
+        roster_version++;
     }
-};
 
-
-struct CompareMacAddress {
-    bool operator()(const ble::address_t &a, const ble::address_t &b) const
+    void connect_controller(int controller_id, ConnectionHandle connection)
     {
-        // printf("Size of data is: %d\n", a.size());
-        // printf("Address of A: ");
-        // print_address(a);
-        // printf("Address of B: ");
-        // print_address(b);
-        auto diff = std::memcmp(a.data(), b.data(), a.size());
-        // printf("The difference is %d\n", diff);
-        return (diff < 0);
+        controllers[controller_id - 1].connection = connection;
+        connected_mask |= id_bit(controller_id);
+        roster_version++;
     }
-};
-
-
 
+    bool is_controller_connected(int controller_id) const
+    {
+        return connected_mask & id_bit(controller_id);
+    }
 
-class ControllerConnectionHandler 
-    : private mbed::NonCopyable<ControllerConnectionHandler>, 
-      public ble::Gap::EventHandler
-{
-    using AdvertisingHandle = ble::advertising_handle_t;
-    using ConnectionHandle = ble::connection_handle_t;
-    using MacAddress = ble::address_t;
-
-    template<typename Value>
-    using MacAddressTable = std::map<MacAddress, Value, CompareMacAddress>;
-
-protected:
-    events::EventQueue &queue;
-    BLE &ble;
-    ble::Gap &gap;
-    ble::GattClient &gatt;
-    ControllerSet &controller_set;
-    MacAddressTable<int> mac_to_id;
-    std::map<ConnectionHandle, MacAddress> conn_to_mac;
-    MacAddressTable<DiscoveredCharacteristic> mac_to_read_char;
-    MacAddressTable<DiscoveredCharacteristic> mac_to_write_char;
-
-    int num_connections;
-
-    uint8_t advertising_buff[MaxAdvPayloadSize];
-    ble::AdvertisingDataBuilder data_builder;
-
-    AdvertisingHandle advertising_handle = ble::LEGACY_ADVERTISING_HANDLE;
+    /**
+     * Mark a controller as usable for a game.
+     *
+     * @return false if it already was.
+     */
+    bool validate_controller(int controller_id)
+    {
+        if (valid_mask & id_bit(controller_id)) {
+            return false;
+        }
+        // a reused id gets a board again once valid
+        controllers[controller_id - 1].game = Controller::NoGame;
+        controllers[controller_id - 1].validated_ms = console_time_ms();
+        valid_mask |= id_bit(controller_id);
+        roster_version++;
+        return true;
+    }
 
-    bool is_connecting = false;
-public:
     /**
-     * Construct a BLEProcess from an event queue and a ble interface.
-     * Call start() to initiate ble processing.
+     * Goes up every time a controller connects, disconnects or becomes
+     * valid.
      */
-    ControllerConnectionHandler(
-            events::EventQueue &event_queue,
-            BLE &ble_interface,
-            ControllerSet &controller_set) :
-        queue(event_queue),
-        ble(ble_interface),
-        gap(ble_interface.gap()),
-        gatt(ble_interface.gattClient()),
-        controller_set(controller_set),
-        data_builder(advertising_buff),
-        num_connections(0)
+    unsigned get_roster_version() const
     {
+        return roster_version;
     }
 
-    ~ControllerConnectionHandler()
+    /**
+     * Controllers that exposed a gesture characteristic, bit id - 1 for
+     * each.
+     */
+    uint32_t get_valid_mask() const
     {
-        stop();
+        return valid_mask.load(std::memory_order_acquire);
     }
 
-    void halt_controllers()
+    ActionQueueStats get_queue_stats() const
     {
-        for (auto pair: this->conn_to_mac) {
-            auto it = this->mac_to_write_char.find(pair.second);
-            if (it != this->mac_to_write_char.end()) {
-                auto characteristic = it->second;
-                uint8_t value = (uint8_t) ControllerSignal::PausedState;
-                characteristic.write(1, &value);
+        ActionQueueStats stats;
+        stats.enqueued = actions_enqueued;
+        for (int id = 1; id <= num_controllers; id++) {
+            const Controller &controller = controllers[id - 1];
+            size_t depth = controller.queue_depth();
+            stats.dropped += controller.dropped_actions();
+            stats.queued_total += depth;
+            if (depth > stats.queued_max) {
+                stats.queued_max = depth;
             }
         }
+        return stats;
     }
 
-    void ready_controllers()
-    {
-        for (auto pair: this->conn_to_mac) {
-            auto it = this->mac_to_write_char.find(pair.second);
-            if (it != this->mac_to_write_char.end()) {
-                auto characteristic = it->second;
-                uint8_t value = (uint8_t) ControllerSignal::ReadyState;
-                characteristic.write(1, &value);
-                // printf(" ready signal sent \r\n");
+private:
+    /**
+     * Take the id of a disconnected controller without a board away from
+     * it, a reconnection of that controller gets a new id.
+     *
+     * The id stays Reclaimed, out of reach of the game thread, until the
+     * new controller is validated.
+     *
+     * @return the id, 0 if there is none.
+     */
+    int reclaim_controller()
+    {
+        for (int id = 1; id <= num_controllers; id++) {
+            Controller &controller = controllers[id - 1];
+            // an id reclaimed before can be again, its controller left
+            // before being validated
+            int game = Controller::NoGame;
+            if (is_controller_connected(id) ||
+                (!controller.game.compare_exchange_strong(game, Controller::Reclaimed) &&
+                 game != Controller::Reclaimed)) {
+                continue;
             }
+            valid_mask &= ~id_bit(id);
+            controller.clear_actions();
+            roster_version++;
+            return id;
         }
+        return 0;
     }
 
-    void start()
-    {
-        // printf("Controller Handler started.\r\n");
+    Controller controllers[MaxKnownControllers];
+    std::atomic<int> num_controllers { 0 };
+    uint32_t connected_mask = 0;
+    std::atomic<uint32_t> valid_mask { 0 };
+    std::atomic<unsigned> roster_version { 0 };
+    std::atomic<unsigned> actions_enqueued { 0 };
+};
 
-        if (ble.hasInitialized()) {
-            printf("Error: the ble instance has already been initialized.\r\n");
-            return;
+
+/**
+ * Maps controller timestamps onto the console clock.
+ *
+ * A controller stamps a gesture before the value can reach the console, so
+ * every sequenced packet received at console time t proves that
+ * offset >= timestamp - t, where offset is controller clock minus console
+ * clock. The estimate is the tightest of these bounds; it is exact up to
+ * the fastest delivery seen so far and never places a gesture before it
+ * was made, so latencies computed from it are never overstated.
+ *
+ * A controller that reboots restarts its clock, but it also reconnects and
+ * gets a fresh estimator with its new connection.
+ */
+class ClockOffsetEstimator {
+public:
+    void add_sample(uint32_t controller_ms, uint32_t received_ms)
+    {
+        // both clocks wrap, only the difference between bounds is ordered
+        uint32_t bound = controller_ms - received_ms;
+        if (!has_offset || (int32_t) (bound - offset) > 0) {
+            offset = bound;
+            has_offset = true;
         }
+    }
 
-        /* handle gap events */
-        gap.setEventHandler(this);
+    bool is_synchronised() const
+    {
+        return has_offset;
+    }
 
-        /* This will inform us off all events so we can schedule their handling
-         * using our event queue */
-        ble.onEventsToProcess(
-            makeFunctionPointer(this, 
-                &ControllerConnectionHandler::schedule_ble_events)
-        );
+    /**
+     * Convert a controller timestamp to console time.
+     */
+    uint32_t to_console_ms(uint32_t controller_ms) const
+    {
+        return controller_ms - offset;
+    }
 
-        ble_error_t error = ble.init(
-            this, &ControllerConnectionHandler::on_init_complete
-        );
+private:
+    bool has_offset = false;
+    uint32_t offset = 0;
+};
 
-        if (error) {
-            print_error(error, "Error returned by BLE::init.\r\n");
-            return;
+/**
+ * State tied to one live link with a controller.
+ *
+ * A connection owns every event scheduled on behalf of the link and the
+ * attribute handles discovered on it, which live in the Controller entry.
+ * close() releases all of them, so nothing keeps firing against a handle
+ * that has gone away.
+ *
+ * Connections sit in a fixed table and are reused: open() starts a link in
+ * an idle entry.
+ */
+class ControllerConnection : private mbed::NonCopyable<ControllerConnection> {
+public:
+    using duration = events::EventQueue::duration;
+    using ConnectionHandle = ControllerTransport::ConnectionHandle;
+    using AttributeHandle = ControllerTransport::AttributeHandle;
+
+    /**
+     * Round trip times of gesture reads on this connection.
+     */
+    struct ReadLatency {
+        unsigned count = 0;
+        uint32_t total_ms = 0;
+        uint32_t max_ms = 0;
+
+        void add(uint32_t ms)
+        {
+            count++;
+            total_ms += ms;
+            if (ms > max_ms) {
+                max_ms = ms;
+            }
         }
+    };
 
-        return;
+    ~ControllerConnection()
+    {
+        close();
     }
 
-    void stop()
+    void open(
+        EventTracker &tracker,
+        ControllerTransport &transport,
+        ConnectionHandle handle,
+        int controller_id,
+        Controller &controller,
+        int slot)
     {
-        if (ble.hasInitialized()) {
-            ble.shutdown();
-            // printf("Controller Handler has stopped.\r\n");
-        }
+        this->tracker = &tracker;
+        this->transport = &transport;
+        this->handle = handle;
+        this->controller_id = controller_id;
+        this->controller = &controller;
+        this->slot = slot;
+        read_pending = false;
+        read_latency = ReadLatency();
+        has_sequence = false;
+        clock = ClockOffsetEstimator();
     }
 
-    const char* name()
+    bool is_open() const
     {
-        static const char name[] = "BlockBashConsole";
-        return name;
+        return controller != nullptr;
     }
 
-    const char* controller_name()
+    ConnectionHandle get_handle() const
     {
-        static const char name[] = "BlockBashController";
-        return name;
+        return handle;
     }
 
-protected:
-    void on_init_complete(BLE::InitializationCompleteCallbackContext *event)
+    int get_controller_id() const
     {
-        if (event->error) {
-            print_error(event->error, "Error during the initialisation\r\n");
-            return;
-        }
-
-        // printf("Ble instance initialized\r\n");
-
-        /* TODO: THIS RUNS ONCE THE BLE INITIALIZATION IS COMPLETED */
+        return controller_id;
+    }
 
-        /* All calls are serialised on the user thread through the event queue */
-        start_activity();
+    int get_slot() const
+    {
+        return slot;
+    }
 
-        this->start_gatt();
+    const ReadLatency &get_read_latency() const
+    {
+        return read_latency;
     }
 
-    void onScanTimeout(const ble::ScanTimeoutEvent &event) override {
-        start_activity();
+    void set_read_characteristic(AttributeHandle value_handle)
+    {
+        controller->gesture_handle = value_handle;
     }
 
-    void onConnectionComplete(const ble::ConnectionCompleteEvent &event) override
+    void set_write_characteristic(AttributeHandle value_handle)
     {
-        /* TODO: ONCE A CONNECTION IS SETUP, THIS RUNS */
-        if (event.getStatus() == BLE_ERROR_NONE) {
-            // printf("\r\nConnected to: \r\n");
-
-            auto addr = event.getPeerAddress();
-            // print_address(addr);
-
-            // If the mac address is not already present, create a new
-            // connection
-            if (this->mac_to_id.find(addr) != this->mac_to_id.end()) {
-                // printf("Mac Address found!\n");
-                this->conn_to_mac.emplace(event.getConnectionHandle(), addr);
-            } // else store the new connection handle 
-            else {
-                // printf("Mac Address not found!\n");
-                num_connections++;
-                this->mac_to_id.emplace(addr, num_connections);
-                this->controller_set.make_controller(num_connections);
-                // printf("Connection handle %d\n", event.getConnectionHandle());
-                this->conn_to_mac.emplace(event.getConnectionHandle(), addr);
-
-                // create the callback that reads the data
-                queue.call_every(1000ms, [this, addr] {
-                    auto it = this->mac_to_read_char.find(addr);
-                    if (it != this->mac_to_read_char.end()) {
-                        auto characteristic = it->second;
-                        characteristic.read();
-                        // printf("This is still getting called...\r\n");
-                    }
-                });
-                queue.call_in(5000ms, [this, addr] {
-                    auto it = this->mac_to_write_char.find(addr);
-                    if (it != this->mac_to_write_char.end()) {
-                        auto characteristic = it->second;
-                        uint8_t value[2];
-                        value[0] = (uint8_t) ControllerSignal::PlayerId;
-                        value[1] = (uint8_t) this->num_connections - 1;
-                        characteristic.write(2, (uint8_t *) &value);
-                        // printf("Signal sent...\r\n");
-                    }
-                });
-            }
+        controller->signal_handle = value_handle;
+    }
 
-            // printf("We are now connected to %d players\r\n", num_connections);
+    bool is_gesture_value(AttributeHandle value_handle) const
+    {
+        return controller->gesture_handle != 0 && value_handle == controller->gesture_handle;
+    }
 
-            this->queue.call([this, event] { this->start_discovery(event); } );
-            this->start_activity();
-        } else {
-            // printf("Failed to connect\r\n");
-            start_activity();
+    /**
+     * Request the current gesture from the controller, if discovered.
+     */
+    void read()
+    {
+        if (controller->gesture_handle) {
+            read_issued_at = Kernel::Clock::now();
+            read_pending = true;
+            transport->read(handle, controller->gesture_handle);
         }
     }
 
-    void onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event) override
+    /**
+     * Record the completion of the last read issued by read().
+     */
+    void on_read_complete()
     {
-        /* THIS RUNS ONCE WE DISCONNECT */
-        const auto &handle = event.getConnectionHandle();
-        // printf("Connection handle %d\n", handle);
-        auto it = this->conn_to_mac.find(handle);
-        auto addr = it->second;
-
-        if (it == this->conn_to_mac.end()) {
-            // printf("Handle not found! \n");
+        if (read_pending) {
+            read_pending = false;
+            auto elapsed = Kernel::Clock::now() - read_issued_at;
+            read_latency.add((uint32_t) elapsed.count());
         }
+    }
 
-        // printf("Size of map is: %d\n", this->mac_to_id.size());
-        // printf("%s", "Address associated with this handle is: ");
-        // print_address(addr);
-
-        auto it2 = this->mac_to_id.find(addr);
-
-        if (it2 == this->mac_to_id.end()) {
-            // printf("Address not found! \n");
+    /**
+     * Check the sequence number of a gesture against the newest one seen
+     * on this connection.
+     *
+     * @param[out] missed gestures skipped since the newest one, they were
+     * overwritten on the controller before the console fetched them.
+     * @return false if the gesture was already received.
+     */
+    bool accept_sequence(uint16_t sequence, unsigned &missed)
+    {
+        missed = 0;
+        if (has_sequence) {
+            int ahead = gesture_sequence_distance(last_sequence, sequence);
+            if (ahead <= 0) {
+                return false;
+            }
+            missed = ahead - 1;
         }
+        last_sequence = sequence;
+        has_sequence = true;
+        return true;
+    }
 
-        auto controller_id = it2->second;
-        
-        // printf("Controller ID: %d\n", player_id);
+    ClockOffsetEstimator &get_clock()
+    {
+        return clock;
+    }
 
-        this->controller_set.disconnect_controller(controller_id);
-        this->conn_to_mac.erase(handle);
-        this->mac_to_read_char.erase(addr);
-        this->mac_to_write_char.erase(addr);
+    /**
+     * Write a signal to the controller, if discovered.
+     */
+    void write(uint16_t length, const uint8_t *value)
+    {
+        if (controller->signal_handle) {
+            transport->write(handle, controller->signal_handle, value, length);
+        }
+    }
 
-        // printf("Disconnected from controller %d\r\n", controller_id);
-        start_activity();
+    /**
+     * Poll the gesture characteristic periodically until close(). The
+     * first read happens after phase, so that connections in different
+     * slots do not poll at the same time.
+     */
+    void start_polling(duration period, duration phase)
+    {
+        tracker->cancel(poll_event);
+        poll_event = tracker->call_in(phase, [this, period] {
+            poll_event = tracker->call_every(period, [this] { read(); });
+            read();
+        });
     }
 
-    void onAdvertisingEnd(const ble::AdvertisingEndEvent &event) override
+    /**
+     * Tell the controller which player it is after the given delay.
+     */
+    void send_player_id_in(duration delay, uint8_t player)
     {
-        start_activity();
+        tracker->cancel(player_id_event);
+        player_id_event = tracker->call_in(delay, [this, player] {
+            player_id_event = TrackedEvent();
+            uint8_t value[2];
+            value[0] = (uint8_t) ControllerSignal::PlayerId;
+            value[1] = player;
+            write(2, value);
+        });
     }
 
-    void onAdvertisingReport(const ble::AdvertisingReportEvent &event) override {
-        /* don't bother with analysing scan result if we're already connecting */
-        // printf("Something\n");
-        // printf("Is connecting %d\n", is_connecting);
-        if (is_connecting) {
+    /**
+     * Cancel every pending event, forget the characteristics and free the
+     * entry.
+     */
+    void close()
+    {
+        if (!is_open()) {
             return;
         }
+        tracker->cancel(poll_event);
+        tracker->cancel(player_id_event);
+        controller->gesture_handle = 0;
+        controller->signal_handle = 0;
+        controller = nullptr;
+    }
 
-        // printf("Got here\n");
-        // printf("Is connectable?: %d\n", event.getType().connectable());
-        // if (!event.getType().connectable()) {
-        //     /* we're only interested in connectable devices */
-        //     return;
-        // }
-
-        ble::AdvertisingDataParser adv_data(event.getPayload());
-
-        /* parse the advertising payload, looking for a discoverable device */
-        while (adv_data.hasNext()) {
-            ble::AdvertisingDataParser::element_t field = adv_data.next();
-
-            // printf("Found a: %s\r\n", field.value.data());
-            /* connect to a discoverable device */
-            if (field.type == ble::adv_data_type_t::COMPLETE_LOCAL_NAME) {
-                //printf("Found a: %s\r\n", field.value.data());
-                if (field.value.size() == strlen(controller_name()) &&
-                    (memcmp(field.value.data(), controller_name(), field.value.size()) == 0)) {
-
-                    // printf("We found \"%s\", connecting...\r\n", controller_name());
-
-                    ble_error_t error = ble.gap().stopScan();
+private:
+    EventTracker *tracker = nullptr;
+    ControllerTransport *transport = nullptr;
+    Controller *controller = nullptr;
+    ConnectionHandle handle = 0;
+    int controller_id = 0;
+    int slot = 0;
+    TrackedEvent poll_event;
+    TrackedEvent player_id_event;
+    bool read_pending = false;
+    Kernel::Clock::time_point read_issued_at;
+    ReadLatency read_latency;
+    bool has_sequence = false;
+    uint16_t last_sequence = 0;
+    ClockOffsetEstimator clock;
+};
 
-                    if (error) {
-                        print_error(error, "Error caused by Gap::stopScan");
-                        return;
-                    }
+/**
+ * Turns controller links into players.
+ *
+ * The handler gives every new controller an id, keeps that id across
+ * reconnections, polls gestures into the ControllerSet and signals the
+ * controllers. The link itself is provided by a ControllerTransport.
+ */
+class ControllerConnectionHandler 
+    : private mbed::NonCopyable<ControllerConnectionHandler>, 
+      public ControllerTransport::EventHandler
+{
+    using ConnectionHandle = ControllerTransport::ConnectionHandle;
+    using AttributeHandle = ControllerTransport::AttributeHandle;
+    using MacAddress = ControllerTransport::MacAddress;
 
-                    const ble::ConnectionParameters connection_params;
+public:
+    /**
+     * Told about roster changes, on the event queue of the handler.
+     */
+    class RosterHandler {
+    public:
+        virtual ~RosterHandler() {}
+
+        /**
+         * A controller connected, disconnected or was validated.
+         *
+         * @param version the roster version after the change.
+         */
+        virtual void on_roster_changed(unsigned version) = 0;
+    };
 
-                    error = ble.gap().connect(
-                        event.getPeerAddressType(),
-                        event.getPeerAddress(),
-                        connection_params
-                    );
+protected:
+    events::EventQueue &queue;
+    ControllerTransport &transport;
+    ControllerSet &controller_set;
+    EventTracker event_tracker;
+    // indexed by connection slot, used_slots tells the open ones
+    ControllerConnection connections[MaxControllers];
+    uint32_t used_slots = 0;
+    // slot of each open link by connection handle, -1 for none; the BLE
+    // stack numbers its links from 1 to DM_CONN_MAX
+    int8_t handle_slots[MaxControllers + 1];
+    RosterHandler *roster_handler = nullptr;
+
+    unsigned duplicate_gestures = 0;
+    unsigned missed_gestures = 0;
 
-                    if (error) {
-                        gap.startScan();
-                        return;
-                    }
+public:
+    /**
+     * Construct a handler from an event queue and a transport.
+     * Call start() to begin accepting controllers.
+     */
+    ControllerConnectionHandler(
+            events::EventQueue &event_queue,
+            ControllerTransport &transport,
+            ControllerSet &controller_set) :
+        queue(event_queue),
+        transport(transport),
+        controller_set(controller_set),
+        event_tracker(event_queue)
+    {
+        std::memset(handle_slots, -1, sizeof(handle_slots));
+    }
 
-                    /* we may have already scan events waiting
-                     * to be processed so we need to remember
-                     * that we are already connecting and ignore them */
-                    is_connecting = true;
+    ~ControllerConnectionHandler()
+    {
+        stop();
+    }
 
-                    return;
-                }
+    void halt_controllers()
+    {
+        for (auto &connection: this->connections) {
+            if (connection.is_open()) {
+                uint8_t value = (uint8_t) ControllerSignal::PausedState;
+                connection.write(1, &value);
             }
         }
     }
 
-    void start_activity()
+    void ready_controllers()
     {
-        // start scanning only once
-        static bool scan = true;
-        // static bool scan = false;
-        if (scan) {
-            queue.call([this]() { start_scanning(); });
-        } else {
-            queue.call([this]() { start_advertising(); });
+        for (auto &connection: this->connections) {
+            if (connection.is_open()) {
+                uint8_t value = (uint8_t) ControllerSignal::ReadyState;
+                connection.write(1, &value);
+                // printf(" ready signal sent \r\n");
+            }
         }
-        scan = !scan;
-        // scan = true;
-        is_connecting = false;
     }
 
-    void start_scanning()
+    const EventTracker &get_event_tracker() const
     {
-        ble::ScanParameters scan_params;
-        gap.setScanParameters(scan_params);
-        ble_error_t ret = gap.startScan(ble::scan_duration_t(ble::millisecond_t(5000)));
-        if (ret == ble_error_t::BLE_ERROR_NONE) {
-            // printf("Started scanning for \"%s\"\r\n", controller_name());
-        } else {
-            // printf("Starting scan failed\r\n");
-        }
+        return event_tracker;
     }
 
-    void start_advertising()
+    /**
+     * Gesture read round trips summed over every live connection.
+     */
+    ControllerConnection::ReadLatency get_read_latency() const
     {
-        ble_error_t error;
-
-        if (gap.isAdvertisingActive(advertising_handle)) {
-            /* we're already advertising */
-            return;
+        ControllerConnection::ReadLatency total;
+        for (auto &connection: this->connections) {
+            if (!connection.is_open()) {
+                continue;
+            }
+            auto &latency = connection.get_read_latency();
+            total.count += latency.count;
+            total.total_ms += latency.total_ms;
+            if (latency.max_ms > total.max_ms) {
+                total.max_ms = latency.max_ms;
+            }
         }
+        return total;
+    }
 
-        ble::AdvertisingParameters adv_params(
-            ble::advertising_type_t::CONNECTABLE_UNDIRECTED,
-            ble::adv_interval_t(ble::millisecond_t(40))
-        );
+    /**
+     * Gestures dropped because an earlier value already carried them.
+     */
+    unsigned get_duplicate_gestures() const
+    {
+        return duplicate_gestures;
+    }
 
-        error = gap.setAdvertisingParameters(advertising_handle, adv_params);
+    /**
+     * Gestures the controllers made but the console never received.
+     */
+    unsigned get_missed_gestures() const
+    {
+        return missed_gestures;
+    }
 
-        if (error) {
-            print_error(error, "");
-            printf("_ble.gap().setAdvertisingParameters() failed\r\n");
-            return;
+    void print_latency_stats() const
+    {
+        for (auto &connection: this->connections) {
+            if (!connection.is_open()) {
+                continue;
+            }
+            auto &latency = connection.get_read_latency();
+            if (latency.count == 0) {
+                continue;
+            }
+            printf("[latency] player %d (slot %d): avg %lu ms, max %lu ms over %u reads\r\n",
+                   connection.get_controller_id(), connection.get_slot(),
+                   (unsigned long) (latency.total_ms / latency.count),
+                   (unsigned long) latency.max_ms, latency.count);
         }
+    }
 
-        data_builder.clear();
-        data_builder.setFlags();
-        data_builder.setName(name());
+    void set_roster_handler(RosterHandler *handler)
+    {
+        roster_handler = handler;
+    }
 
-        /* Set payload for the set */
-        error = gap.setAdvertisingPayload(
-            advertising_handle, data_builder.getAdvertisingData()
-        );
+    void start()
+    {
+        // printf("Controller Handler started.\r\n");
+        transport.start(this);
+    }
 
-        if (error) {
-            print_error(error, "Gap::setAdvertisingPayload() failed\r\n");
-            return;
+    void stop()
+    {
+        // close the connections first so their events are cancelled
+        for (auto &connection: this->connections) {
+            connection.close();
         }
+        used_slots = 0;
+        std::memset(handle_slots, -1, sizeof(handle_slots));
+        transport.stop();
+    }
 
-        error = gap.startAdvertising(advertising_handle, ble::adv_duration_t(ble::millisecond_t(4000)));
+protected:
+    void on_connected(ConnectionHandle handle, const MacAddress &addr) override
+    {
+        /* TODO: ONCE A CONNECTION IS SETUP, THIS RUNS */
+        // printf("\r\nConnected to: \r\n");
+
+        // Controllers keep their id across reconnections, only a new
+        // mac address creates a new controller
+        int controller_id = this->controller_set.find_controller(addr);
+        if (controller_id == 0) {
+            // printf("Mac Address not found!\n");
+            controller_id = this->controller_set.make_controller(addr);
+        }
 
-        if (error) {
-            print_error(error, "Gap::startAdvertising() failed\r\n");
+        // printf("Connection handle %d\n", handle);
+        int slot = handle <= MaxControllers ? acquire_slot() : -1;
+        if (controller_id == 0 || slot < 0) {
+            // no room left in the tables, free the link for a controller
+            // that can play
+            if (slot >= 0) {
+                release_slot(slot);
+            }
+            this->transport.disconnect(handle);
             return;
         }
+        handle_slots[handle] = slot;
+        this->controller_set.connect_controller(controller_id, handle);
+        post_roster_change();
+
+        ControllerConnection &connection = this->connections[slot];
+        connection.open(
+            event_tracker, transport, handle, controller_id,
+            this->controller_set.get_controller(controller_id), slot
+        );
 
-        // printf("Advertising as \"%s\"\r\n", name());
-    }
+        // poll the gesture characteristic and assign the player number;
+        // both events are cancelled when this connection goes away
+        connection.start_polling(
+            GesturePollPeriod, GesturePollPeriod * slot / MaxControllers
+        );
+        connection.send_player_id_in(5000ms, (uint8_t) (controller_id - 1));
 
-    void schedule_ble_events(BLE::OnEventsToProcessCallbackContext *event)
-    {
-        queue.call(mbed::callback(&event->ble, &BLE::processEvents));
-    }
+#if MBED_CONF_APP_INSTRUMENTATION
+        event_tracker.print_stats("connect");
+#endif
 
-    void on_write(const GattWriteCallbackParams *response)
-    {
-        // printf(" signal delivered! \r\n");
-        // if (response->handle == gesture_characteristic.getValueHandle()) {
-        //     this->queue.call_in(5000ms, []{ gesture_characteristic.read(); });
-        // }
+        // printf("We are now connected to controller %d\r\n", controller_id);
+
+        this->queue.call([this, handle] { this->transport.discover(handle); });
     }
 
-    void on_read(const GattReadCallbackParams *response)
+    void on_disconnected(ConnectionHandle handle) override
     {
-        // std::cout << "This runs: on read!" << std::endl;
-
-        // fetch the controller corresponding to this connection
-        auto &address = this->conn_to_mac.find(response->connHandle)->second;
-        auto &player_id = this->mac_to_id.find(address)->second;
-
-        // compute the action read from the controller
-        uint8_t received_value = response->data[response->offset];
-        Action action = parse_action(received_value);
-        uint8_t magnitude = response->data[response->offset + 1];
+        /* THIS RUNS ONCE WE DISCONNECT */
+        // printf("Connection handle %d\n", handle);
+        ControllerConnection *connection = find_connection(handle);
 
-        // printf("Data length: %d\r\n", response->len);
-        // for (int i = 0; i < response->len; i++) {
-        //     printf("%d ", response->data[i]);
-        // }
-        // printf("\r\n");
-        // printf("Action is number: %d\r\n", received_value);
-        // printf("Magnitude is: %d\r\n", magnitude);
-        // printf("Queueing action...\r\n");
+        if (connection) {
+            auto controller_id = connection->get_controller_id();
+            // printf("Controller ID: %d\n", controller_id);
 
-        this->controller_set.queue_to_controller(player_id, action, magnitude);
-    }
+            this->controller_set.disconnect_controller(controller_id);
+            release_slot(connection->get_slot());
+            handle_slots[handle] = -1;
+            post_roster_change();
 
-    void start_gatt() {
-        ble::WriteCallback_t write_callback;
-        ble::ReadCallback_t read_callback;
+            // closing the connection cancels its pending events
+            connection->close();
+        } else {
+            // printf("Handle not found! \n");
+        }
 
-        write_callback.attach(this, &ControllerConnectionHandler::on_write);
-        read_callback.attach(this, &ControllerConnectionHandler::on_read);
+#if MBED_CONF_APP_INSTRUMENTATION
+        event_tracker.print_stats("disconnect");
+#endif
 
-        this->gatt.onDataRead(read_callback);
-        this->gatt.onDataWritten(write_callback);
+        // printf("Disconnected from controller %d\r\n", controller_id);
     }
 
-    void start_discovery(const ble::ConnectionCompleteEvent &event)
+    void on_data(
+        ConnectionHandle handle, AttributeHandle value_handle,
+        const uint8_t *data, uint16_t length) override
     {
-        ServiceDiscovery::TerminationCallback_t termination_callback;
-        ServiceDiscovery::ServiceCallback_t service_callback;
-        ServiceDiscovery::CharacteristicCallback_t characteristic_callback;
+        // std::cout << "This runs: on read!" << std::endl;
 
-        termination_callback.attach(this, &ControllerConnectionHandler::discovery_termination);
-        service_callback.attach(this, &ControllerConnectionHandler::service_discovery);
-        characteristic_callback.attach(this, &ControllerConnectionHandler::characteristic_discovery);
+        // fetch the controller corresponding to this connection, reads
+        // can still complete after the link went down
+        ControllerConnection *found = find_connection(handle);
+        if (!found) {
+            return;
+        }
+        ControllerConnection &connection = *found;
+        GestureBatch batch;
+        if (!connection.is_gesture_value(value_handle) ||
+            !parse_gesture_batch(data, length, batch)) {
+            return;
+        }
+        int player_id = connection.get_controller_id();
+        connection.on_read_complete();
+
+        // a value can carry several gestures, oldest first
+        uint32_t received_ms = console_time_ms();
+        for (int i = 0; i < batch.count; i++) {
+            const GesturePacket &packet = batch.gestures[i];
+
+            // drop gestures that were already received and place the
+            // others on the console clock; old controllers send neither a
+            // sequence nor a timestamp, their gestures are dated on arrival
+            uint32_t gesture_ms = received_ms;
+            if (packet.sequenced) {
+                unsigned missed;
+                if (!connection.accept_sequence(packet.sequence, missed)) {
+                    duplicate_gestures++;
+                    continue;
+                }
+                missed_gestures += missed;
+
+                // sequence 0 is the value before the first gesture, it
+                // carries no timestamp
+                if (packet.sequence != 0) {
+                    ClockOffsetEstimator &clock = connection.get_clock();
+                    clock.add_sample(packet.timestamp_ms, received_ms);
+                    gesture_ms = clock.to_console_ms(packet.timestamp_ms);
+                }
+            }
 
-        this->gatt.onServiceDiscoveryTermination(termination_callback);
-        this->gatt.launchServiceDiscovery(
-            event.getConnectionHandle(),
-            service_callback,
-            characteristic_callback,
-            ControllerServiceUUID//,
-            // GestureCharacteristicUUID
-        );
-    }
+            // compute the action read from the controller
+            Action action = parse_action(packet.action);
+            if (action == Action::NoOp) {
+                continue;
+            }
 
-    void discovery_termination(ble::connection_handle_t connectionHandle)
-    {
-        if (gesture_characteristic_found) {
-            gesture_characteristic_found = false;
-            // queue.call([]{ gesture_characteristic.read(); });
+            // printf("Action is number: %d\r\n", packet.action);
+            // printf("Magnitude is: %d\r\n", packet.magnitude);
+            // printf("Queueing action...\r\n");
+
+            this->controller_set.queue_to_controller(
+                player_id, ControllerAction{action, packet.magnitude, gesture_ms}
+            );
         }
     }
 
-    void characteristic_discovery(const DiscoveredCharacteristic *characteristic)
+    void on_characteristic_discovered(
+        ConnectionHandle handle, uint16_t uuid, AttributeHandle value_handle) override
     {
-        // printf("%x\r\n", characteristic->getUUID().getShortUUID());
-        if (characteristic->getUUID().getShortUUID() == GestureCharacteristicUUID) {
+        // printf("%x\r\n", uuid);
+        ControllerConnection *found = find_connection(handle);
+        if (!found) {
+            return;
+        }
+        ControllerConnection &connection = *found;
+
+        if (uuid == GestureCharacteristicUUID) {
             // printf("Gesture characteristic detected!\r\n");
             // printf("Validating controller!\r\n");
 
-            auto handle = characteristic->getConnectionHandle();
-            auto it1 = this->conn_to_mac.find(handle);
-            auto addr = it1->second;
-            auto it2 = this->mac_to_id.find(addr);
-            auto controller_id = it2->second;
-
-            this->controller_set.validate_controller(controller_id);
+            if (this->controller_set.validate_controller(connection.get_controller_id())) {
+                post_roster_change();
+            }
 
             // printf("Now controller %d can be used for game\r\n", controller_id);
-            
-            gesture_characteristic = *characteristic;
-            gesture_characteristic_found = true;
 
-            characteristic->read();
-            this->mac_to_read_char.emplace(addr, *characteristic);
-            
+            connection.set_read_characteristic(value_handle);
+            connection.read();
         }
-        else if (characteristic->getUUID().getShortUUID() == SignalCharacteristicUUID) {
+        else if (uuid == SignalCharacteristicUUID) {
             // printf("Signal characteristic detected!\r\n");
 
-            auto handle = characteristic->getConnectionHandle();
-            auto it1 = this->conn_to_mac.find(handle);
-            auto addr = it1->second;
-            auto it2 = this->mac_to_id.find(addr);
-            auto controller_id = it2->second;
+            connection.set_write_characteristic(value_handle);
+        }
+    }
 
-            // printf("Now controller %d can be used for game\r\n", controller_id);
-            
-            gesture_characteristic = *characteristic;
-            gesture_characteristic_found = true;
+    /**
+     * Let the roster handler know, once the current callback is done.
+     */
+    void post_roster_change()
+    {
+        if (roster_handler) {
+            this->queue.call([this] {
+                roster_handler->on_roster_changed(controller_set.get_roster_version());
+            });
+        }
+    }
 
-            this->mac_to_write_char.emplace(addr, *characteristic);
+    /**
+     * The open connection with this handle, looked up once per value
+     * received.
+     */
+    ControllerConnection *find_connection(ConnectionHandle handle)
+    {
+        if (handle > MaxControllers || handle_slots[handle] < 0) {
+            return nullptr;
         }
+        return &this->connections[handle_slots[handle]];
     }
 
-    void service_discovery(const DiscoveredService *service)
+    /**
+     * Take the lowest free connection slot.
+     *
+     * @return the slot, -1 if all are taken.
+     */
+    int acquire_slot()
     {
-        if (service->getUUID().shortOrLong() == UUID::UUID_TYPE_SHORT) {
-            if (service->getUUID().getShortUUID() == ControllerServiceUUID) {
-                // printf("Controller Service Found!\r\n");
+        for (int slot = 0; slot < MaxControllers; slot++) {
+            if (!(used_slots & (1u << slot))) {
+                used_slots |= (1u << slot);
+                return slot;
             }
         }
+        return -1;
     }
-};
 
+    void release_slot(int slot)
+    {
+        used_slots &= ~(1u << slot);
+    }
+};
 
+#endif /* CONTROLLER_H_ */
@@ -0,0 +1,249 @@
+#ifndef CONTROLLER_PROTOCOL_H_
+#define CONTROLLER_PROTOCOL_H_
+
+#include <cstdint>
+#include <chrono>
+
+/*
+ * GATT layout and signal values shared by the console and the controllers,
+ * whatever transport carries them.
+ */
+
+const static uint16_t ControllerServiceUUID = 0xA000;
+const static uint16_t GestureCharacteristicUUID = 0xA001;
+const static uint16_t SignalCharacteristicUUID = 0xA002;
+
+/**
+ * Value of the gesture characteristic.
+ *
+ * Laid out little endian as [action:1][magnitude:1][sequence:2][timestamp:4].
+ * The sequence number goes up by one for every new gesture, so a read that
+ * returns the same sequence as the previous one carries nothing new. The
+ * timestamp is the controller clock in milliseconds when the gesture was
+ * made. Sequence 0 is the value before the first gesture and has no
+ * timestamp; the sequence skips it when it wraps, 0xFFFF is followed by 1.
+ *
+ * The magnitude is the strength of the gesture: a move of magnitude N goes
+ * N columns, a soft drop N rows. 0 counts as a single step.
+ *
+ * Controllers running older firmware send only [action, magnitude]; those
+ * values have no sequence and every read counts as a new gesture.
+ */
+struct GesturePacket {
+    uint8_t action;
+    uint8_t magnitude;
+    uint16_t sequence;
+    uint32_t timestamp_ms;
+    bool sequenced;
+};
+
+static const uint16_t GesturePacketSize = 8;
+static const uint16_t LegacyGesturePacketSize = 2;
+
+/**
+ * Sequence of the gesture after this one, 0 skipped.
+ */
+inline uint16_t next_gesture_sequence(uint16_t sequence)
+{
+    return sequence == 0xFFFF ? 1 : sequence + 1;
+}
+
+/**
+ * Sequence of the gesture before this one, 0 skipped.
+ */
+inline uint16_t previous_gesture_sequence(uint16_t sequence)
+{
+    return sequence <= 1 ? 0xFFFF : sequence - 1;
+}
+
+/**
+ * Gestures from the one with sequence from to the one with sequence to,
+ * within half the sequence range. Not positive if to is not newer.
+ */
+inline int gesture_sequence_distance(uint16_t from, uint16_t to)
+{
+    int distance = (int16_t) (to - from);
+    // 0 is skipped on the way from 0xFFFF to 1
+    if (distance > 0 && from != 0 && to < from) {
+        distance--;
+    }
+    return distance;
+}
+
+/**
+ * Decode a gesture characteristic value.
+ *
+ * @return false if the value is too short to hold a gesture.
+ */
+inline bool parse_gesture_packet(const uint8_t *data, uint16_t length, GesturePacket &packet)
+{
+    if (length < LegacyGesturePacketSize) {
+        return false;
+    }
+
+    packet.action = data[0];
+    packet.magnitude = data[1];
+    packet.sequenced = length >= GesturePacketSize;
+    if (packet.sequenced) {
+        packet.sequence = data[2] | (data[3] << 8);
+        packet.timestamp_ms = (uint32_t) data[4]
+                            | ((uint32_t) data[5] << 8)
+                            | ((uint32_t) data[6] << 16)
+                            | ((uint32_t) data[7] << 24);
+    } else {
+        packet.sequence = 0;
+        packet.timestamp_ms = 0;
+    }
+    return true;
+}
+
+/**
+ * Encode a gesture characteristic value, the inverse of
+ * parse_gesture_packet.
+ */
+inline void write_gesture_packet(const GesturePacket &packet, uint8_t *data)
+{
+    data[0] = packet.action;
+    data[1] = packet.magnitude;
+    data[2] = packet.sequence & 0xFF;
+    data[3] = packet.sequence >> 8;
+    data[4] = packet.timestamp_ms & 0xFF;
+    data[5] = (packet.timestamp_ms >> 8) & 0xFF;
+    data[6] = (packet.timestamp_ms >> 16) & 0xFF;
+    data[7] = (packet.timestamp_ms >> 24) & 0xFF;
+}
+
+/**
+ * Batched value of the gesture characteristic.
+ *
+ * A controller keeps its last few gestures in a ring and publishes all of
+ * them, so gestures made between two polls are not overwritten:
+ *
+ *     [0x80 | count:1][sequence:2][timestamp:4]
+ *     count x [action:1][magnitude:1][age:2]
+ *
+ * sequence and timestamp belong to the newest gesture. Entries go from the
+ * oldest to the newest, each one sequence before the next, 0 skipped as
+ * by next_gesture_sequence; entry i was made age milliseconds before the
+ * newest one. The ring is not
+ * cleared by reads, the console keeps the entries whose sequence it has
+ * not seen yet.
+ *
+ * The leading flag cannot be an action code, so batches are told apart
+ * from single and legacy values.
+ */
+static const uint8_t GestureBatchFlag = 0x80;
+static const uint8_t MaxGestureBatch = 8;
+static const uint16_t GestureBatchHeaderSize = 7;
+static const uint16_t GestureBatchEntrySize = 4;
+static const uint16_t MaxGestureBatchSize =
+    GestureBatchHeaderSize + MaxGestureBatch * GestureBatchEntrySize;
+
+/**
+ * Gestures carried by one characteristic value, oldest first.
+ */
+struct GestureBatch {
+    uint8_t count;
+    GesturePacket gestures[MaxGestureBatch];
+};
+
+/**
+ * Decode a gesture characteristic value in any of its formats: batched,
+ * single or legacy.
+ *
+ * @return false if the value is malformed.
+ */
+inline bool parse_gesture_batch(const uint8_t *data, uint16_t length, GestureBatch &batch)
+{
+    if (length == 0 || !(data[0] & GestureBatchFlag)) {
+        batch.count = 1;
+        return parse_gesture_packet(data, length, batch.gestures[0]);
+    }
+
+    uint8_t count = data[0] & ~GestureBatchFlag;
+    if (count > MaxGestureBatch ||
+        length < GestureBatchHeaderSize + count * GestureBatchEntrySize) {
+        return false;
+    }
+
+    uint16_t sequence = data[1] | (data[2] << 8);
+    uint32_t timestamp_ms = (uint32_t) data[3]
+                          | ((uint32_t) data[4] << 8)
+                          | ((uint32_t) data[5] << 16)
+                          | ((uint32_t) data[6] << 24);
+
+    batch.count = count;
+    // numbered from the newest back, so a batch across the wrap skips 0
+    const uint8_t *entry = data + GestureBatchHeaderSize + count * GestureBatchEntrySize;
+    for (int i = count - 1; i >= 0; i--) {
+        entry -= GestureBatchEntrySize;
+        GesturePacket &packet = batch.gestures[i];
+        packet.action = entry[0];
+        packet.magnitude = entry[1];
+        packet.sequence = sequence;
+        packet.timestamp_ms = timestamp_ms - (entry[2] | (entry[3] << 8));
+        packet.sequenced = true;
+        sequence = previous_gesture_sequence(sequence);
+    }
+    return true;
+}
+
+/**
+ * Encode gestures, oldest first, as a batched value.
+ *
+ * @param data room for at least MaxGestureBatchSize bytes.
+ * @return the length of the value.
+ */
+inline uint16_t write_gesture_batch(const GesturePacket *gestures, uint8_t count, uint8_t *data)
+{
+    if (count > MaxGestureBatch) {
+        gestures += count - MaxGestureBatch;
+        count = MaxGestureBatch;
+    }
+
+    const GesturePacket &newest = gestures[count ? count - 1 : 0];
+    uint16_t sequence = count ? newest.sequence : 0;
+    uint32_t timestamp_ms = count ? newest.timestamp_ms : 0;
+
+    data[0] = GestureBatchFlag | count;
+    data[1] = sequence & 0xFF;
+    data[2] = sequence >> 8;
+    data[3] = timestamp_ms & 0xFF;
+    data[4] = (timestamp_ms >> 8) & 0xFF;
+    data[5] = (timestamp_ms >> 16) & 0xFF;
+    data[6] = (timestamp_ms >> 24) & 0xFF;
+
+    uint8_t *entry = data + GestureBatchHeaderSize;
+    for (int i = 0; i < count; i++, entry += GestureBatchEntrySize) {
+        uint32_t age = timestamp_ms - gestures[i].timestamp_ms;
+        if (age > 0xFFFF) {
+            age = 0xFFFF;
+        }
+        entry[0] = gestures[i].action;
+        entry[1] = gestures[i].magnitude;
+        entry[2] = age & 0xFF;
+        entry[3] = age >> 8;
+    }
+    return GestureBatchHeaderSize + count * GestureBatchEntrySize;
+}
+
+enum class ControllerSignal : uint8_t {
+    PlayerId  = 0x15,
+    ReadyState   = 0x20,
+    PausedState  = 0x40
+};
+
+// The BLE stack caps the number of simultaneous links, see the
+// cordio.max-connections option in mbed_app.json. Host builds have no
+// stack limit of their own and use the console default.
+#ifdef DM_CONN_MAX
+static const int MaxControllers = DM_CONN_MAX;
+#else
+static const int MaxControllers = 8;
+#endif
+
+// Gesture reads are spread evenly over the poll period according to the
+// connection slot, rather than issued in one burst
+static const std::chrono::milliseconds GesturePollPeriod(1000);
+
+#endif /* CONTROLLER_PROTOCOL_H_ */
@@ -0,0 +1,112 @@
+#ifndef CONTROLLER_TRANSPORT_H_
+#define CONTROLLER_TRANSPORT_H_
+
+#include <array>
+#include <cstdint>
+
+/**
+ * How long a transport's events waited in the event queue, from the
+ * moment the link handed them over to the moment they were dispatched.
+ */
+struct DispatchLatency {
+    unsigned count = 0;
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+
+    void add(uint32_t us)
+    {
+        count++;
+        total_us += us;
+        if (us > max_us) {
+            max_us = us;
+        }
+    }
+};
+
+/**
+ * The link to the controllers, as seen by the connection handler.
+ *
+ * A transport finds controllers, connects to them, discovers their
+ * characteristics and moves attribute values back and forth. On the board
+ * this is the BLE stack; on a host it can be emulated over sockets so the
+ * console loop runs without hardware.
+ *
+ * All EventHandler callbacks are delivered on the event queue the
+ * transport was built with, and all operations must be called from it.
+ */
+class ControllerTransport {
+public:
+    // from 1 to MaxControllers, as the BLE stack numbers its links; a
+    // handle is reused once its link is down
+    using ConnectionHandle = uint16_t;
+    using AttributeHandle = uint16_t;
+    using MacAddress = std::array<uint8_t, 6>;
+
+    class EventHandler {
+    public:
+        virtual ~EventHandler() {}
+
+        /**
+         * A controller is connected and can be discovered.
+         */
+        virtual void on_connected(ConnectionHandle connection, const MacAddress &address) = 0;
+
+        /**
+         * The link went down, the handle is no longer valid.
+         */
+        virtual void on_disconnected(ConnectionHandle connection) = 0;
+
+        /**
+         * A characteristic of the controller service has been discovered.
+         */
+        virtual void on_characteristic_discovered(
+            ConnectionHandle connection, uint16_t uuid, AttributeHandle value_handle) = 0;
+
+        /**
+         * An attribute value arrived, either as a read response or as a
+         * notification.
+         */
+        virtual void on_data(
+            ConnectionHandle connection, AttributeHandle value_handle,
+            const uint8_t *data, uint16_t length) = 0;
+    };
+
+    virtual ~ControllerTransport() {}
+
+    /**
+     * Start looking for controllers and report to handler.
+     */
+    virtual void start(EventHandler *handler) = 0;
+
+    virtual void stop() = 0;
+
+    /**
+     * Discover the controller service on a connection.
+     */
+    virtual void discover(ConnectionHandle connection) = 0;
+
+    /**
+     * Request an attribute value, delivered later through on_data.
+     */
+    virtual void read(ConnectionHandle connection, AttributeHandle value_handle) = 0;
+
+    virtual void write(
+        ConnectionHandle connection, AttributeHandle value_handle,
+        const uint8_t *data, uint16_t length) = 0;
+
+    /**
+     * Drop a connection, on_disconnected follows once the link is down.
+     */
+    virtual void disconnect(ConnectionHandle connection) = 0;
+
+    /**
+     * Queueing delay of the link events so far, written by the thread
+     * dispatching the transport queue.
+     */
+    virtual DispatchLatency get_dispatch_latency() const
+    {
+        return DispatchLatency();
+    }
+};
+
+#endif /* CONTROLLER_TRANSPORT_H_ */
@@ -0,0 +1,132 @@
+#ifndef EVENT_TRACKER_H_
+#define EVENT_TRACKER_H_
+
+#include <cstddef>
+#include <cstdio>
+
+#include "mbed.h"
+#include <events/mbed_events.h>
+
+/**
+ * Handle to an event posted through an EventTracker.
+ */
+struct TrackedEvent {
+    int id = 0;
+    size_t bytes = 0;
+
+    bool is_pending() const
+    {
+        return id != 0;
+    }
+};
+
+/**
+ * Book-keeping for events that outlive the call that posted them.
+ *
+ * The EventQueue does not expose how many events it holds, so every
+ * periodic or delayed event posted on behalf of a controller goes through
+ * this tracker. It counts the events that are still pending and estimates
+ * the queue memory they pin down, so connect/disconnect cycles can be
+ * checked for leaked timers.
+ */
+class EventTracker {
+public:
+    using duration = events::EventQueue::duration;
+
+    explicit EventTracker(events::EventQueue &queue)
+        : queue(queue), live_events(0), live_bytes(0)
+    {}
+
+    /**
+     * Post a one-shot event. It stops being counted once it has run or
+     * has been cancelled.
+     */
+    template<typename F>
+    TrackedEvent call_in(duration delay, F f)
+    {
+        TrackedEvent event;
+        event.bytes = event_footprint<F>();
+        size_t bytes = event.bytes;
+        event.id = queue.call_in(delay, [this, f, bytes]() mutable {
+            release(bytes);
+            f();
+        });
+        if (event.id) {
+            acquire(event.bytes);
+        }
+        return event;
+    }
+
+    /**
+     * Post a periodic event. It is counted until it is cancelled.
+     */
+    template<typename F>
+    TrackedEvent call_every(duration period, F f)
+    {
+        TrackedEvent event;
+        event.bytes = event_footprint<F>();
+        event.id = queue.call_every(period, f);
+        if (event.id) {
+            acquire(event.bytes);
+        }
+        return event;
+    }
+
+    /**
+     * Cancel an event posted through this tracker and clear its handle.
+     * Cancelling a one-shot event that already ran is a no-op.
+     */
+    void cancel(TrackedEvent &event)
+    {
+        if (event.is_pending() && queue.cancel(event.id)) {
+            release(event.bytes);
+        }
+        event = TrackedEvent();
+    }
+
+    int get_live_events() const
+    {
+        return live_events;
+    }
+
+    size_t get_live_bytes() const
+    {
+        return live_bytes;
+    }
+
+    void print_stats(const char *tag) const
+    {
+        printf("[events] %s: %d live, ~%u of %u bytes\r\n",
+               tag, live_events, (unsigned) live_bytes,
+               (unsigned) EVENTS_QUEUE_SIZE);
+    }
+
+private:
+    /**
+     * Estimated queue memory used by one event wrapping a callable of
+     * type F.
+     */
+    template<typename F>
+    static constexpr size_t event_footprint()
+    {
+        return EVENTS_EVENT_SIZE + sizeof(F);
+    }
+
+    void acquire(size_t bytes)
+    {
+        live_events++;
+        live_bytes += bytes;
+    }
+
+    void release(size_t bytes)
+    {
+        live_events--;
+        live_bytes -= bytes;
+    }
+
+    events::EventQueue &queue;
+    int live_events;
+    size_t live_bytes;
+};
+
+#endif /* EVENT_TRACKER_H_ */
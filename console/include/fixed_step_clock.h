@@ -0,0 +1,110 @@
+#ifndef FIXED_STEP_CLOCK_H_
+#define FIXED_STEP_CLOCK_H_
+
+#include <chrono>
+#include <cstdint>
+
+#include "mbed.h"
+
+/**
+ * Fixed timestep bookkeeping for the game loop.
+ *
+ * The loop wakes up about once a step and asks advance() how many steps
+ * are due. Steps are counted from the start of the clock, not from the
+ * last wake up, so the game runs the same number of steps whatever the
+ * wake up jitter: a late wake up runs the missed steps back to back. After
+ * a stall longer than max_catch_up steps the rest is skipped and the clock
+ * is re-anchored, rather than running a long burst of stale steps.
+ */
+class FixedStepClock {
+public:
+    using duration = std::chrono::microseconds;
+
+    struct Stats {
+        unsigned wakeups = 0;
+        unsigned steps = 0;
+        // steps run after the first one of a wake up
+        unsigned catch_up_steps = 0;
+        unsigned skipped_steps = 0;
+        // wake ups that found more than one step due
+        unsigned overruns = 0;
+        // how late wake ups were against the step schedule
+        uint64_t jitter_total_us = 0;
+        uint32_t jitter_max_us = 0;
+    };
+
+    FixedStepClock(duration step, int max_catch_up)
+        : step(step), max_catch_up(max_catch_up)
+    {
+    }
+
+    void start()
+    {
+        timer.reset();
+        timer.start();
+        anchor_us = 0;
+        anchored_steps = 0;
+    }
+
+    /**
+     * Number of steps to run now, at most max_catch_up.
+     */
+    int advance()
+    {
+        uint64_t now_us = timer.elapsed_time().count();
+        uint64_t step_us = step.count();
+
+        uint64_t due = (now_us - anchor_us) / step_us;
+        if (due <= anchored_steps) {
+            stats.wakeups++;
+            return 0;
+        }
+        uint64_t pending = due - anchored_steps;
+
+        // lateness against the first step that became due
+        uint64_t ideal_us = anchor_us + (anchored_steps + 1) * step_us;
+        uint32_t jitter_us = (uint32_t) (now_us - ideal_us);
+        stats.wakeups++;
+        stats.jitter_total_us += jitter_us;
+        if (jitter_us > stats.jitter_max_us) {
+            stats.jitter_max_us = jitter_us;
+        }
+        if (pending > 1) {
+            stats.overruns++;
+        }
+
+        int run = pending > (uint64_t) max_catch_up ? max_catch_up : (int) pending;
+        if (pending > (uint64_t) max_catch_up) {
+            stats.skipped_steps += (unsigned) (pending - max_catch_up);
+            // start counting again from the last step run
+            anchor_us += (anchored_steps + pending) * step_us;
+            anchored_steps = 0;
+        } else {
+            anchored_steps += run;
+        }
+
+        stats.steps += run;
+        stats.catch_up_steps += run - 1;
+        return run;
+    }
+
+    duration get_step() const
+    {
+        return step;
+    }
+
+    const Stats &get_stats() const
+    {
+        return stats;
+    }
+
+private:
+    duration step;
+    int max_catch_up;
+    Timer timer;
+    uint64_t anchor_us = 0;
+    uint64_t anchored_steps = 0;
+    Stats stats;
+};
+
+#endif /* FIXED_STEP_CLOCK_H_ */
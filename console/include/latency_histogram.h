@@ -0,0 +1,77 @@
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * Histogram of latencies in milliseconds with power of two buckets:
+ * bucket 0 holds 0ms, bucket i holds [2^(i-1), 2^i) and the last bucket
+ * everything from 2^(Buckets-2) ms up.
+ */
+class LatencyHistogram {
+public:
+    static const int Buckets = 14;
+
+    void add(uint32_t ms)
+    {
+        int bucket = 0;
+        while (bucket < Buckets - 1 && ms >= (1u << bucket)) {
+            bucket++;
+        }
+        counts[bucket]++;
+        count++;
+        total_ms += ms;
+        if (ms > max_ms) {
+            max_ms = ms;
+        }
+    }
+
+    unsigned get_count() const
+    {
+        return count;
+    }
+
+    unsigned get_bucket(int bucket) const
+    {
+        return counts[bucket];
+    }
+
+    /**
+     * Lowest latency counted in a bucket.
+     */
+    static uint32_t bucket_floor(int bucket)
+    {
+        return bucket == 0 ? 0 : (1u << (bucket - 1));
+    }
+
+    uint32_t get_average_ms() const
+    {
+        return count ? (uint32_t) (total_ms / count) : 0;
+    }
+
+    uint32_t get_max_ms() const
+    {
+        return max_ms;
+    }
+
+    void print(const char *tag) const
+    {
+        printf("[%s] %u samples, avg %lu ms, max %lu ms\r\n", tag, count,
+               (unsigned long) get_average_ms(), (unsigned long) max_ms);
+        for (int bucket = 0; bucket < Buckets; bucket++) {
+            if (counts[bucket]) {
+                printf("[%s]   >= %5lu ms: %u\r\n", tag,
+                       (unsigned long) bucket_floor(bucket), counts[bucket]);
+            }
+        }
+    }
+
+private:
+    unsigned counts[Buckets] = {};
+    unsigned count = 0;
+    uint64_t total_ms = 0;
+    uint32_t max_ms = 0;
+};
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -0,0 +1,111 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Fixed capacity FIFO between one producer and one consumer, without locks
+ * or heap allocation.
+ *
+ * When the ring is full, push() drops the oldest element to make room: for
+ * player input the latest gestures matter most. Dropped elements are
+ * counted.
+ *
+ * Both sides advance the read index with a compare and swap, so the
+ * producer can take the oldest element away while the consumer is copying
+ * it; the consumer then sees its swap fail and retries with the next one.
+ * That copy may be torn, which is why elements must be trivially copyable.
+ */
+template<typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "elements are copied without synchronisation");
+
+public:
+    static const size_t capacity = Capacity;
+
+    /**
+     * Producer side: append an element, dropping the oldest one if the
+     * ring is full.
+     *
+     * @return false if an element was dropped.
+     */
+    bool push(const T &value)
+    {
+        uint32_t head = write_index.load(std::memory_order_relaxed);
+        uint32_t tail = read_index.load(std::memory_order_acquire);
+        bool kept_all = true;
+
+        while (head - tail >= Capacity) {
+            // the consumer may take the oldest element first, either way
+            // a slot is free once the read index has moved
+            if (read_index.compare_exchange_weak(
+                    tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                kept_all = false;
+                break;
+            }
+        }
+
+        slots[head & (Capacity - 1)] = value;
+        write_index.store(head + 1, std::memory_order_release);
+        return kept_all;
+    }
+
+    /**
+     * Consumer side: take the oldest element.
+     *
+     * @return false if the ring is empty.
+     */
+    bool pop(T &value)
+    {
+        uint32_t tail = read_index.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t head = write_index.load(std::memory_order_acquire);
+            if (tail == head) {
+                return false;
+            }
+            value = slots[tail & (Capacity - 1)];
+            if (read_index.compare_exchange_weak(
+                    tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Elements waiting, exact only from the producer or the consumer.
+     */
+    size_t size() const
+    {
+        uint32_t head = write_index.load(std::memory_order_acquire);
+        uint32_t tail = read_index.load(std::memory_order_acquire);
+        return head - tail;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * Elements dropped by push() since construction.
+     */
+    unsigned get_dropped() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    T slots[Capacity];
+    std::atomic<uint32_t> write_index { 0 };
+    std::atomic<uint32_t> read_index { 0 };
+    std::atomic<unsigned> dropped { 0 };
+};
+
+#endif /* SPSC_RING_H_ */
@@ -0,0 +1,192 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Hierarchical timer wheel over a fixed set of timers, counted in ticks.
+ *
+ * Timers are numbered 0 to Capacity - 1 and linked into the slot of the
+ * tick they expire at, so arming and cancelling a timer is a constant time
+ * unlink and link whatever the number of timers armed. Each tick only
+ * visits the timers that expire on it.
+ *
+ * The first level has one slot per tick for the next 64 ticks, each
+ * further level one slot per 64 ticks of the level below. When the first
+ * level wraps, the next slot of the level above is moved down. Three
+ * levels cover 2^18 ticks, longer delays are clamped to that.
+ *
+ * Timers are kept in the wheel itself, nothing is allocated.
+ */
+template<size_t Capacity>
+class TimerWheel {
+    static_assert(Capacity > 0 && Capacity < 0xFFFF, "timers are numbered on 16 bits");
+
+public:
+    static const int SlotBits = 6;
+    static const int Slots = 1 << SlotBits;
+    static const int Levels = 3;
+    static const uint32_t MaxDelay = (1u << (SlotBits * Levels)) - 1;
+
+    TimerWheel()
+    {
+        for (int level = 0; level < Levels; level++) {
+            for (int slot = 0; slot < Slots; slot++) {
+                heads[level][slot] = Nil;
+            }
+        }
+        for (size_t timer = 0; timer < Capacity; timer++) {
+            nodes[timer].armed = false;
+        }
+    }
+
+    /**
+     * Arm a timer to expire delay ticks from now, at least one. A timer
+     * already armed is moved to its new expiry.
+     */
+    void arm(int timer, uint32_t delay)
+    {
+        if (delay == 0) {
+            delay = 1;
+        } else if (delay > MaxDelay) {
+            delay = MaxDelay;
+        }
+
+        if (nodes[timer].armed) {
+            unlink(timer);
+        }
+        nodes[timer].expires = now + delay;
+        nodes[timer].armed = true;
+        link(timer);
+    }
+
+    /**
+     * @return false if the timer was not armed.
+     */
+    bool cancel(int timer)
+    {
+        if (!nodes[timer].armed) {
+            return false;
+        }
+        unlink(timer);
+        nodes[timer].armed = false;
+        return true;
+    }
+
+    bool is_armed(int timer) const
+    {
+        return nodes[timer].armed;
+    }
+
+    /**
+     * Ticks left until an armed timer expires.
+     */
+    uint32_t remaining(int timer) const
+    {
+        return nodes[timer].expires - now;
+    }
+
+    /**
+     * Move one tick forward and call on_expired(timer) for every timer
+     * expiring on it. The callback may arm or cancel any timer, including
+     * the one that expired.
+     *
+     * @return the number of timers that expired.
+     */
+    template<typename F>
+    int advance(F &&on_expired)
+    {
+        now++;
+
+        // refill the first level from the levels above as it wraps
+        if ((now & (Slots - 1)) == 0) {
+            if (((now >> SlotBits) & (Slots - 1)) == 0) {
+                cascade(2);
+            }
+            cascade(1);
+        }
+
+        int expired = 0;
+        uint16_t &head = heads[0][now & (Slots - 1)];
+        while (head != Nil) {
+            int timer = head;
+            unlink(timer);
+            nodes[timer].armed = false;
+            expired++;
+            on_expired(timer);
+        }
+        return expired;
+    }
+
+    uint32_t get_now() const
+    {
+        return now;
+    }
+
+private:
+    static const uint16_t Nil = 0xFFFF;
+
+    struct Node {
+        uint32_t expires;
+        uint16_t next;
+        uint16_t prev;
+        uint8_t level;
+        uint8_t slot;
+        bool armed;
+    };
+
+    void link(int timer)
+    {
+        Node &node = nodes[timer];
+        uint32_t delta = node.expires - now;
+
+        int level = 0;
+        while (level < Levels - 1 && delta >= (1u << (SlotBits * (level + 1)))) {
+            level++;
+        }
+        node.level = level;
+        node.slot = (node.expires >> (SlotBits * level)) & (Slots - 1);
+
+        uint16_t &head = heads[node.level][node.slot];
+        node.prev = Nil;
+        node.next = head;
+        if (head != Nil) {
+            nodes[head].prev = timer;
+        }
+        head = timer;
+    }
+
+    void unlink(int timer)
+    {
+        Node &node = nodes[timer];
+        if (node.prev != Nil) {
+            nodes[node.prev].next = node.next;
+        } else {
+            heads[node.level][node.slot] = node.next;
+        }
+        if (node.next != Nil) {
+            nodes[node.next].prev = node.prev;
+        }
+    }
+
+    /**
+     * Move the timers of the current slot of a level down, they all expire
+     * within the span of the level below.
+     */
+    void cascade(int level)
+    {
+        uint16_t &head = heads[level][(now >> (SlotBits * level)) & (Slots - 1)];
+        while (head != Nil) {
+            int timer = head;
+            unlink(timer);
+            link(timer);
+        }
+    }
+
+    Node nodes[Capacity];
+    uint16_t heads[Levels][Slots];
+    uint32_t now = 0;
+};
+
+#endif /* TIMER_WHEEL_H_ */
@@ -0,0 +1,246 @@
+#include "BlockBashGame.h"
+
+BlockBashGame::BlockBashGame(ControllerTransport &transport, EventQueue &queue, EventQueue &game_queue)
+    : num_games(0),
+      started(false),
+      frames(0),
+      frame_time_total_us(0),
+      frame_time_max_us(0),
+      actions_applied(0),
+      moves_applied(0),
+      render_countdown(RenderPeriodSteps),
+      clock(GameStepPeriod, MaxCatchUpSteps),
+      event_queue(queue),
+      game_queue(game_queue),
+      transport(transport),
+      renderer(),
+      game_manager(renderer, GameStepPeriod),
+      controller_set(),
+      connection_manager(event_queue, transport, controller_set)
+{
+    // boards are assigned as soon as a controller is validated
+    connection_manager.set_roster_handler(this);
+    connection_manager.start();
+}
+
+void BlockBashGame::setup_controllers() {
+    // printf(" %d controllers connected \r\n", num_games);
+    uint32_t valid = this->controller_set.get_valid_mask();
+    if (num_games == MaxControllers || started) return;
+    for (int id = 1; id <= MaxKnownControllers; id++) {
+        if (!(valid & ControllerSet::id_bit(id))) continue;
+        // printf(" controller id %d \r\n", id);
+        if (!this->controller_set.assign_game(id, num_games)) continue;
+
+        const Controller &controller = this->controller_set.get_controller(id);
+        this->game_to_controller[num_games] = id;
+        num_games++;
+        this->game_manager.addGame();
+        // the board has been sent to the display
+        roster_latency.add(console_time_ms() - controller.validated_ms);
+        if (num_games == MaxControllers) return;
+    }
+}
+
+void BlockBashGame::on_roster_changed(unsigned version) {
+    // boards belong to the game thread
+    game_queue.call([this, version] {
+        setup_controllers();
+        this->game_manager.setRosterVersion(version);
+    });
+}
+
+void BlockBashGame::apply_input(int game) {
+    using namespace Tetris;
+
+    auto controller_id = this->game_to_controller[game];
+
+    // take everything the player did since the last step, up to the
+    // budget, and fold it into as few moves as possible
+    ActionCoalescer coalescer;
+    ControllerAction queued;
+    int taken = 0;
+    uint32_t now_ms = console_time_ms();
+    while (taken < InputBudgetPerFrame &&
+           this->controller_set.dequeue_from_controller(controller_id, queued)) {
+        taken++;
+        coalescer.add(queued.action, queued.magnitude);
+        actions_applied++;
+        gesture_latency.add(now_ms - queued.gesture_ms);
+        board_latency[game].add(now_ms - queued.gesture_ms);
+        // the rest stays queued for the next piece
+        if (coalescer.has_dropped()) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < coalescer.size(); i++) {
+        CoalescedAction move = coalescer.get(i);
+        // printf(" action is: %d x%d\r\n", move.action, move.count);
+
+        TetrisAction tetris_action;
+        switch (move.action) {
+        case Action::Left:
+            tetris_action = TetrisAction::MoveLeft;
+            break;
+
+        case Action::Right:
+            tetris_action = TetrisAction::MoveRight;
+            break;
+
+        case Action::Down:
+            tetris_action = TetrisAction::Drop;
+            break;
+
+        case Action::SoftDrop:
+            tetris_action = TetrisAction::SoftDrop;
+            break;
+
+        case Action::FlipRight:
+            tetris_action = TetrisAction::Rotate;
+            break;
+
+        case Action::Save:
+            tetris_action = TetrisAction::Store;
+            break;
+
+        default:
+            // other operations not supported yet
+            continue;
+        }
+
+        game_manager.pushAction(game, tetris_action, move.count);
+        moves_applied++;
+    }
+}
+
+void BlockBashGame::run_game_step() {
+    for (int game = 0; game < num_games; game++) {
+        apply_input(game);
+    }
+    game_manager.runStep();
+    render_countdown--;
+}
+
+void BlockBashGame::run_game_frame() {
+    int steps = clock.advance();
+    if (steps == 0) {
+        return;
+    }
+
+    Timer frame_timer;
+    frame_timer.start();
+
+    for (int i = 0; i < steps; i++) {
+        run_game_step();
+    }
+
+    // a frame that caught up on several steps renders once
+    if (render_countdown <= 0) {
+        game_manager.renderGames();
+        render_countdown = RenderPeriodSteps;
+    }
+
+    uint32_t frame_time_us = (uint32_t) frame_timer.elapsed_time().count();
+    frames++;
+    frame_time_total_us += frame_time_us;
+    if (frame_time_us > frame_time_max_us) {
+        frame_time_max_us = frame_time_us;
+    }
+}
+
+void BlockBashGame::start_game() {
+    // the links are driven from the transport queue
+    event_queue.call([this] {
+        this->connection_manager.ready_controllers();
+    });
+    this->game_manager.playGame();
+}
+
+void BlockBashGame::request_start() {
+    if (started) return;
+    started = true;
+    start_game();
+    game_queue.call_in(5000ms, [this] {
+        clock.start();
+        game_queue.call_every(GameStepPeriod, [this] {
+            run_game_frame();
+        });
+    });
+}
+
+BlockBashGame::Stats BlockBashGame::get_stats() const {
+    Stats stats;
+    stats.frames = frames;
+    stats.frame_time_total_us = frame_time_total_us;
+    stats.frame_time_max_us = frame_time_max_us;
+    stats.actions_applied = actions_applied;
+    stats.moves_applied = moves_applied;
+    stats.frames_rendered = game_manager.getFramesRendered();
+    stats.clock = clock.get_stats();
+    stats.queues = controller_set.get_queue_stats();
+    stats.gesture_latency = gesture_latency;
+    for (int game = 0; game < num_games; game++) {
+        stats.board_latency[game] = board_latency[game];
+    }
+    stats.players = num_games;
+    stats.roster_version = controller_set.get_roster_version();
+    stats.roster_version_shown = game_manager.getRosterVersion();
+    stats.roster_latency = roster_latency;
+    return stats;
+}
+
+BlockBashGame::ConnectionStats BlockBashGame::get_connection_stats() const {
+    ConnectionStats stats;
+    stats.read_latency = connection_manager.get_read_latency();
+    stats.transport_dispatch = transport.get_dispatch_latency();
+    stats.duplicate_gestures = connection_manager.get_duplicate_gestures();
+    stats.missed_gestures = connection_manager.get_missed_gestures();
+    return stats;
+}
+
+void BlockBashGame::print_stats() {
+    Stats stats = get_stats();
+    printf("[frames] %u frames, avg %lu us, max %lu us, %u renders\r\n",
+           stats.frames,
+           (unsigned long) (stats.frames ? stats.frame_time_total_us / stats.frames : 0),
+           (unsigned long) stats.frame_time_max_us, stats.frames_rendered);
+    printf("[steps] %u steps in %u wake ups, %u caught up in %u late frames, %u skipped, "
+           "jitter avg %lu us, max %lu us\r\n",
+           stats.clock.steps, stats.clock.wakeups, stats.clock.catch_up_steps,
+           stats.clock.overruns, stats.clock.skipped_steps,
+           (unsigned long) (stats.clock.wakeups ? stats.clock.jitter_total_us / stats.clock.wakeups : 0),
+           (unsigned long) stats.clock.jitter_max_us);
+    printf("[actions] %u queued, %u applied as %u moves, "
+           "%u waiting (max %u per player), %u dropped\r\n",
+           stats.queues.enqueued, stats.actions_applied, stats.moves_applied,
+           (unsigned) stats.queues.queued_total, (unsigned) stats.queues.queued_max,
+           stats.queues.dropped);
+    stats.gesture_latency.print("gesture-to-apply");
+    for (int game = 0; game < stats.players; game++) {
+        const LatencyHistogram &latency = stats.board_latency[game];
+        printf("[board %d] %u gestures, avg %lu ms, max %lu ms to apply\r\n",
+               game, latency.get_count(),
+               (unsigned long) latency.get_average_ms(), (unsigned long) latency.get_max_ms());
+    }
+    printf("[roster] version %u, %u shown, %d players\r\n",
+           stats.roster_version, stats.roster_version_shown, stats.players);
+    stats.roster_latency.print("validation-to-board");
+
+    // the link figures are written by the transport queue, read them there
+    event_queue.call([this] { print_connection_stats(); });
+}
+
+void BlockBashGame::print_connection_stats() {
+    this->connection_manager.get_event_tracker().print_stats("periodic");
+    this->connection_manager.print_latency_stats();
+
+    ConnectionStats stats = get_connection_stats();
+    printf("[dispatch] %u link events, waited avg %lu us, max %lu us\r\n",
+           stats.transport_dispatch.count,
+           (unsigned long) (stats.transport_dispatch.count
+               ? stats.transport_dispatch.total_us / stats.transport_dispatch.count : 0),
+           (unsigned long) stats.transport_dispatch.max_us);
+    printf("[gestures] %u received again, %u missed\r\n",
+           stats.duplicate_gestures, stats.missed_gestures);
+}
@@ -40,28 +40,40 @@ namespace Tetris {
         return rotatedPiece;
     }
 
-    FallingPiece TetrisGame::shiftDownOne() {
-        FallingPiece newPiece {};
-        for (auto& square : currentPiece) {
-            newPiece.push_back({square.y + 1, square.x});
+    int TetrisGame::freeDistance(int dx, int dy, int limit) const {
+        int distance = limit;
+        for (auto& block : currentPiece) {
+            // no block can go further than the ones already swept
+            int free = 0;
+            int x = block.x + dx;
+            int y = block.y + dy;
+            while (free < distance && y < HEIGHT && x >= 0 && x < WIDTH && board[y][x] == 0) {
+                free++;
+                x += dx;
+                y += dy;
+            }
+            distance = free;
         }
 
-        return newPiece;
+        return distance;
     }
 
-    bool TetrisGame::moveDownOneChecked() {
-        // Move the current piece down
-        FallingPiece newPiece = shiftDownOne();
+    int TetrisGame::moveDown(int rows) {
+        int free = freeDistance(0, 1, rows);
+        for (auto& square : currentPiece) {
+            square.y += free;
+        }
+        return free;
+    }
 
-        // Check if overlaps with any existing blocks
-        if (checkCollision(newPiece)) {
-            // Overlaps with existing block, so spawn a new piece
+    bool TetrisGame::moveDownChecked(int rows) {
+        // Hit an existing block on the way, so spawn a new piece
+        if (moveDown(rows) < rows) {
             placePiece();
             spawnPiece();
             //std::cout << "Placed piece" << std::endl;
             return false;
         }
-        currentPiece = newPiece;
         return true;
     }
 
@@ -143,37 +155,18 @@ namespace Tetris {
         }
     }
 
-    bool TetrisGame::moveLeft() {
-        FallingPiece newPiece = currentPiece;
+    bool TetrisGame::moveHorizontal(int columns) {
+        int direction = columns < 0 ? -1 : 1;
 
-        // Move the piece left
-        for (auto& block : newPiece) {
-            block.x -= 1;
-        }
-
-        // Check if the piece can move left
-        if (checkCollision(newPiece)) {
+        // Check how far the piece can move
+        int free = freeDistance(direction, 0, columns * direction);
+        if (free == 0) {
             return false;
         }
 
-        currentPiece = newPiece;
-        return true;
-    }
-
-    bool TetrisGame::moveRight() {
-        FallingPiece newPiece = currentPiece;
-
-        // Move the piece right
-        for (auto& block : newPiece) {
-            block.x += 1;
-        }
-
-        // Check if the piece can move right
-        if (checkCollision(newPiece)) {
-            return false;
+        for (auto& block : currentPiece) {
+            block.x += free * direction;
         }
-
-        currentPiece = newPiece;
         return true;
     }
 
@@ -240,49 +233,64 @@ namespace Tetris {
     }
 
 
-    void TetrisGame::tick() {
-        if (state != TetrisGameState::Playing) {
+    bool TetrisGame::fall() {
+        return state == TetrisGameState::Playing && moveDown(1) == 1;
+    }
+
+    bool TetrisGame::isResting() const {
+        return state == TetrisGameState::Playing && freeDistance(0, 1, 1) == 0;
+    }
+
+    void TetrisGame::lock() {
+        if (!isResting()) {
             return;
         }
 
-        moveDownOneChecked();
+        placePiece();
+        spawnPiece();
     }
 
 
-    void TetrisGame::applyAction(TetrisAction action) {
-        if (state != TetrisGameState::Playing) {
+    void TetrisGame::applyAction(TetrisAction action, int count) {
+        if (state != TetrisGameState::Playing || count <= 0) {
             return;
         }
 
         // Apply the correct action
-        bool drop = false;
         switch (action) {
             case TetrisAction::MoveLeft:
-                moveLeft();
+                moveHorizontal(-count);
                 break;
             case TetrisAction::MoveRight:
-                moveRight();
+                moveHorizontal(count);
                 break;
             case TetrisAction::Rotate:
-                moveRotate();
+                for (int turn = 0; turn < count % 4; turn++) {
+                    moveRotate();
+                }
                 break;
             case TetrisAction::Drop:
-                drop = true;
+                // further than any piece can fall, so it lands
+                moveDownChecked(HEIGHT);
+                break;
+            case TetrisAction::SoftDrop:
+                // the lock delay places the piece if it lands
+                moveDown(count);
                 break;
             case TetrisAction::Store:
                 moveStore();
                 break;
         }
-
-        while (drop) {
-            drop = moveDownOneChecked();
-        }
     }
 
     int TetrisGame::getScore() const {
         return score;
     }
 
+    int TetrisGame::getLevel() const {
+        return score / LINES_PER_LEVEL;
+    }
+
     TetrisGame::TetrisGameState TetrisGame::getState() const {
         return state;
     }
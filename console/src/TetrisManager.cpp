@@ -1,5 +1,7 @@
 #include "TetrisManager.h"
 
+#include <new>
+
 namespace Tetris {
 
     void TetrisGameManager::playGame() {
@@ -7,37 +9,91 @@ namespace Tetris {
             return;
         }
 
-        for (auto& game : games) {
-            game->start();
+        running = true;
+        GameSpan games = getGames();
+        for (int i = 0; i < numGames; i++) {
+            games[i].start();
+            armGravity(i);
         }
         renderGames();
     }
 
     int TetrisGameManager::addGame() {
-        TetrisGame* game = new TetrisGame();
-        games.push_back(game);
-        renderer.setGames(games.size());
+        if (numGames == MAX_GAMES) {
+            return -1;
+        }
+
+        new (getGames().end()) TetrisGame();
+        numGames++;
+        renderer.setGames(numGames);
         renderGames();
-        return games.size() - 1;
+        return numGames - 1;
     }
 
-    void TetrisGameManager::pushAction(int gameIndex, TetrisAction action) {
-        if (gameIndex < 0 || gameIndex >= games.size()) {
+    void TetrisGameManager::pushAction(int gameIndex, TetrisAction action, int count) {
+        if (gameIndex < 0 || gameIndex >= numGames) {
             return;
         }
 
-        games[gameIndex]->applyAction(action);
-        renderer.renderGames(games);
+        // the render period of the game loop sends every board, rendering
+        // here as well would send all boards once per action
+        getGames()[gameIndex].applyAction(action, count);
+        updateLockDelay(gameIndex);
     }
 
     void TetrisGameManager::renderGames() {
-        renderer.renderGames(games);
+        renderer.renderGames(getGames());
+    }
+
+    void TetrisGameManager::runStep() {
+        timers.advance([this](int timer) {
+            onTimer(timer);
+        });
     }
 
-    void TetrisGameManager::runTick() {
-        for (auto& game : games) {
-            game->tick();
+    void TetrisGameManager::onTimer(int timer) {
+        int gameIndex = timer / TIMERS_PER_GAME;
+        TetrisGame* game = &getGames()[gameIndex];
+
+        switch (static_cast<GameTimer>(timer % TIMERS_PER_GAME)) {
+            case GameTimer::Gravity:
+                if (game->getState() != TetrisGame::TetrisGameState::Playing) {
+                    // the game is over, nothing falls any more
+                    return;
+                }
+                game->fall();
+                armGravity(gameIndex);
+                break;
+            case GameTimer::LockDelay:
+                game->lock();
+                break;
         }
-        renderGames();
+        updateLockDelay(gameIndex);
+    }
+
+    uint32_t TetrisGameManager::toSteps(std::chrono::milliseconds period) const {
+        uint32_t steps = period / stepPeriod;
+        return steps > 0 ? steps : 1;
+    }
+
+    void TetrisGameManager::armGravity(int gameIndex) {
+        timers.arm(timerId(gameIndex, GameTimer::Gravity), toSteps(getGravityPeriod(gameIndex)));
+    }
+
+    void TetrisGameManager::updateLockDelay(int gameIndex) {
+        int timer = timerId(gameIndex, GameTimer::LockDelay);
+        if (!getGames()[gameIndex].isResting()) {
+            timers.cancel(timer);
+        } else if (!timers.is_armed(timer)) {
+            timers.arm(timer, toSteps(std::chrono::milliseconds(LOCK_DELAY_MS)));
+        }
+    }
+
+    std::chrono::milliseconds TetrisGameManager::getGravityPeriod(int gameIndex) const {
+        int level = 0;
+        if (gameIndex >= 0 && gameIndex < numGames) {
+            level = gameData()[gameIndex].getLevel();
+        }
+        return std::chrono::milliseconds(1000 / (TICKS_PER_SECOND + level));
     }
 };
@@ -5,15 +5,15 @@
 namespace Tetris {
 
 
-    void TetrisRenderer::renderGame(const TetrisGame* game) {
-        TetrisGame::TetrisGameState state = game->getState();
+    void TetrisRenderer::renderGame(const TetrisGame& game) {
+        TetrisGame::TetrisGameState state = game.getState();
         get_render_stream() << TetrisGame::gameStateToInt(state) << std::endl;
         if (state != TetrisGame::TetrisGameState::Playing) {
             return;
         }
 
-        TetrisBoard viewBoard = game->getViewBoard();
-        TetrisPiece piece = game->getStoredPiece();
+        TetrisBoard viewBoard = game.getViewBoard();
+        TetrisPiece piece = game.getStoredPiece();
         for (int y = 0; y < HEIGHT; y++) {
             std::ostream& ostream = get_render_stream();
             for (int x = 0; x < WIDTH; x++) {
@@ -22,12 +22,13 @@ namespace Tetris {
             ostream << std::endl;
         }
         get_render_stream() << piece << std::endl; // Stored Piece
-        get_render_stream() << game->getScore() << std::endl; // Score
+        get_render_stream() << game.getScore() << std::endl; // Score
     }
 
-    void TetrisRenderer::renderGames(const std::vector<TetrisGame*> games) {
+    void TetrisRenderer::renderGames(GameSpan games) {
         get_render_stream() << "FRAME" << std::endl;
-        for (const TetrisGame* game : games) {
+        framesRendered++;
+        for (const TetrisGame& game : games) {
             renderGame(game);
         }
     }
@@ -35,5 +36,14 @@ namespace Tetris {
     void TetrisRenderer::setGames(int numgames) {
         get_render_stream() << "SETGAMES" << std::endl;
         get_render_stream() << std::to_string(numgames) << std::endl;
+
+        // Lay the boards out on the most square grid that fits them all
+        int columns = 1;
+        while (columns * columns < numgames) {
+            columns++;
+        }
+        int rows = numgames > 0 ? (numgames + columns - 1) / columns : 0;
+        get_render_stream() << "LAYOUT" << std::endl;
+        get_render_stream() << columns << " " << rows << std::endl;
     }
 }
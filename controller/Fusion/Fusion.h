@@ -16,10 +16,12 @@ extern "C" {
 #endif
 
 #include "FusionAhrs.h"
+#include "FusionAhrsFixed.h"
 #include "FusionAxes.h"
 #include "FusionCalibration.h"
 #include "FusionCompass.h"
 #include "FusionConvention.h"
+#include "FusionFixed.h"
 #include "FusionMath.h"
 #include "FusionOffset.h"
 
@@ -10,7 +10,7 @@
 
 #include <float.h> // FLT_MAX
 #include "FusionAhrs.h"
-#include <math.h> // atan2f, cosf, powf, sinf
+#include <math.h> // atan2f, cosf, fabsf, powf, sinf
 
 //------------------------------------------------------------------------------
 // Definitions
@@ -332,6 +332,149 @@ void FusionAhrsUpdateNoMagnetometer(FusionAhrs *const ahrs, const FusionVector g
     }
 }
 
+/**
+ * @brief Updates the AHRS algorithm with a block of gyroscope and
+ * accelerometer measurements sampled at a constant rate, such as a FIFO
+ * burst.  Equivalent to calling FusionAhrsUpdateNoMagnetometer for each
+ * sample, to within rounding.  Values derived from the settings and the
+ * delta time are calculated once per block and the state is kept in local
+ * variables between samples.  Samples during initialisation or following a
+ * gyroscope range overflow are passed to FusionAhrsUpdateNoMagnetometer.
+ * @param ahrs AHRS algorithm structure.
+ * @param gyroscope Gyroscope measurements in degrees per second.
+ * @param accelerometer Accelerometer measurements in g.
+ * @param numberOfSamples Number of samples.
+ * @param deltaTime Delta time between samples in seconds.
+ * @param quaternions Quaternions after every decimation samples, or NULL.
+ * @param decimation Samples per quaternion written, 0 is taken as 1.
+ * @return Number of quaternions written.
+ */
+size_t FusionAhrsUpdateBatch(FusionAhrs *const ahrs, const FusionVector *const gyroscope, const FusionVector *const accelerometer, const size_t numberOfSamples, const float deltaTime, FusionQuaternion *const quaternions, const size_t decimation) {
+
+    // Calculate constants for the block
+    const float gyroscopeRange = ahrs->settings.gyroscopeRange;
+    const float accelerationRejection = ahrs->settings.accelerationRejection;
+    const int recoveryTriggerPeriod = (int) ahrs->settings.recoveryTriggerPeriod;
+    const float gravitySign = ahrs->settings.convention == FusionConventionNed ? -1.0f : 1.0f;
+    const float gyroscopeScale = FusionDegreesToRadians(0.5f) * deltaTime;
+    const size_t samplesPerQuaternion = decimation == 0 ? 1 : decimation;
+
+    size_t numberOfQuaternions = 0;
+    size_t sampleIndex = 0;
+    while (sampleIndex < numberOfSamples) {
+
+        // Update per sample during initialisation
+        if (ahrs->initialising) {
+            FusionAhrsUpdateNoMagnetometer(ahrs, gyroscope[sampleIndex], accelerometer[sampleIndex], deltaTime);
+            sampleIndex++;
+            if ((quaternions != NULL) && ((sampleIndex % samplesPerQuaternion) == 0)) {
+                quaternions[numberOfQuaternions++] = ahrs->quaternion;
+            }
+            continue;
+        }
+
+        // Load state
+        const float feedbackScale = ahrs->rampedGain * deltaTime;
+        float qw = ahrs->quaternion.element.w;
+        float qx = ahrs->quaternion.element.x;
+        float qy = ahrs->quaternion.element.y;
+        float qz = ahrs->quaternion.element.z;
+        FusionVector halfAccelerometerFeedback = ahrs->halfAccelerometerFeedback;
+        bool accelerometerIgnored = ahrs->accelerometerIgnored;
+        int accelerationRecoveryTrigger = ahrs->accelerationRecoveryTrigger;
+        int accelerationRecoveryTimeout = ahrs->accelerationRecoveryTimeout;
+        bool rangeExceeded = false;
+
+        for (; sampleIndex < numberOfSamples; sampleIndex++) {
+            const FusionVector g = gyroscope[sampleIndex];
+            const FusionVector a = accelerometer[sampleIndex];
+
+            // Leave the reinitialisation to the per sample update
+            if ((fabsf(g.axis.x) > gyroscopeRange) || (fabsf(g.axis.y) > gyroscopeRange) || (fabsf(g.axis.z) > gyroscopeRange)) {
+                rangeExceeded = true;
+                break;
+            }
+
+            // Calculate accelerometer feedback
+            float feedbackX = 0.0f;
+            float feedbackY = 0.0f;
+            float feedbackZ = 0.0f;
+            accelerometerIgnored = true;
+            if (FusionVectorIsZero(a) == false) {
+
+                // Direction of gravity indicated by algorithm scaled by 0.5
+                const FusionVector halfGravity = {.axis = {
+                        .x = gravitySign * (qx * qz - qw * qy),
+                        .y = gravitySign * (qy * qz + qw * qx),
+                        .z = gravitySign * (qw * qw - 0.5f + qz * qz),
+                }};
+                halfAccelerometerFeedback = Feedback(FusionVectorNormalise(a), halfGravity);
+
+                if (FusionVectorMagnitudeSquared(halfAccelerometerFeedback) <= accelerationRejection) {
+                    accelerometerIgnored = false;
+                    accelerationRecoveryTrigger -= 9;
+                } else {
+                    accelerationRecoveryTrigger += 1;
+                }
+                if (accelerationRecoveryTrigger > accelerationRecoveryTimeout) {
+                    accelerationRecoveryTimeout = 0;
+                    accelerometerIgnored = false;
+                } else {
+                    accelerationRecoveryTimeout = recoveryTriggerPeriod;
+                }
+                accelerationRecoveryTrigger = Clamp(accelerationRecoveryTrigger, 0, recoveryTriggerPeriod);
+
+                if (accelerometerIgnored == false) {
+                    feedbackX = halfAccelerometerFeedback.axis.x;
+                    feedbackY = halfAccelerometerFeedback.axis.y;
+                    feedbackZ = halfAccelerometerFeedback.axis.z;
+                }
+            }
+
+            // Adjusted half gyroscope in radians multiplied by delta time
+            const float x = g.axis.x * gyroscopeScale + feedbackX * feedbackScale;
+            const float y = g.axis.y * gyroscopeScale + feedbackY * feedbackScale;
+            const float z = g.axis.z * gyroscopeScale + feedbackZ * feedbackScale;
+
+            // Integrate rate of change of quaternion
+            const FusionQuaternion quaternion = FusionQuaternionNormalise((FusionQuaternion) {.element = {
+                    .w = qw - qx * x - qy * y - qz * z,
+                    .x = qx + qw * x + qy * z - qz * y,
+                    .y = qy + qw * y - qx * z + qz * x,
+                    .z = qz + qw * z + qx * y - qy * x,
+            }});
+            qw = quaternion.element.w;
+            qx = quaternion.element.x;
+            qy = quaternion.element.y;
+            qz = quaternion.element.z;
+
+            if ((quaternions != NULL) && (((sampleIndex + 1) % samplesPerQuaternion) == 0)) {
+                quaternions[numberOfQuaternions++] = quaternion;
+            }
+        }
+
+        // Store state
+        const FusionQuaternion quaternion = {.element = {.w = qw, .x = qx, .y = qy, .z = qz}};
+        ahrs->quaternion = quaternion;
+        ahrs->halfAccelerometerFeedback = halfAccelerometerFeedback;
+        ahrs->accelerometerIgnored = accelerometerIgnored;
+        ahrs->accelerationRecoveryTrigger = accelerationRecoveryTrigger;
+        ahrs->accelerationRecoveryTimeout = accelerationRecoveryTimeout;
+        ahrs->magnetometerIgnored = true;
+        ahrs->accelerometer = accelerometer[sampleIndex - (rangeExceeded ? 0 : 1)];
+
+        // Pass the overflowing sample to the per sample update
+        if (rangeExceeded) {
+            FusionAhrsUpdateNoMagnetometer(ahrs, gyroscope[sampleIndex], accelerometer[sampleIndex], deltaTime);
+            sampleIndex++;
+            if ((quaternions != NULL) && ((sampleIndex % samplesPerQuaternion) == 0)) {
+                quaternions[numberOfQuaternions++] = ahrs->quaternion;
+            }
+        }
+    }
+    return numberOfQuaternions;
+}
+
 /**
  * @brief Updates the AHRS algorithm using the gyroscope, accelerometer, and
  * heading measurements.
@@ -14,6 +14,7 @@
 #include "FusionConvention.h"
 #include "FusionMath.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 //------------------------------------------------------------------------------
 // Definitions
@@ -87,6 +88,8 @@ void FusionAhrsUpdate(FusionAhrs *const ahrs, const FusionVector gyroscope, cons
 
 void FusionAhrsUpdateNoMagnetometer(FusionAhrs *const ahrs, const FusionVector gyroscope, const FusionVector accelerometer, const float deltaTime);
 
+size_t FusionAhrsUpdateBatch(FusionAhrs *const ahrs, const FusionVector *const gyroscope, const FusionVector *const accelerometer, const size_t numberOfSamples, const float deltaTime, FusionQuaternion *const quaternions, const size_t decimation);
+
 void FusionAhrsUpdateExternalHeading(FusionAhrs *const ahrs, const FusionVector gyroscope, const FusionVector accelerometer, const float heading, const float deltaTime);
 
 FusionQuaternion FusionAhrsGetQuaternion(const FusionAhrs *const ahrs);
@@ -0,0 +1,322 @@
+/**
+ * @file FusionAhrsFixed.c
+ * @brief Fixed-point build of the AHRS algorithm without magnetometer.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "FusionAhrsFixed.h"
+#include <math.h> // ldexp, llround, powf, sinf
+#include <stdlib.h> // abs
+
+//------------------------------------------------------------------------------
+// Definitions
+
+/**
+ * @brief Initial gain used during the initialisation, as FusionAhrs.c.
+ */
+#define INITIAL_GAIN (10.0f)
+
+/**
+ * @brief Initialisation period in seconds, as FusionAhrs.c.
+ */
+#define INITIALISATION_PERIOD (3.0f)
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static inline FusionFixedVector HalfGravity(const FusionAhrsFixed *const ahrs);
+
+static inline FusionFixedVector Feedback(const FusionFixedVector sensor, const FusionFixedVector reference);
+
+static inline int Clamp(const int value, const int min, const int max);
+
+static inline int64_t ToFixed(const double value, const int fractionalBits);
+
+static void ZeroHeading(FusionAhrsFixed *const ahrs);
+
+//------------------------------------------------------------------------------
+// Functions
+
+/**
+ * @brief Initialises the AHRS algorithm structure with the default settings
+ * of FusionAhrsInitialise.
+ * @param ahrs AHRS algorithm structure.
+ * @param deltaTime Delta time between samples in seconds.
+ */
+void FusionAhrsFixedInitialise(FusionAhrsFixed *const ahrs, const float deltaTime) {
+    const FusionAhrsSettings settings = {
+            .convention = FusionConventionNwu,
+            .gain = 0.5f,
+            .gyroscopeRange = 0.0f,
+            .accelerationRejection = 90.0f,
+            .magneticRejection = 90.0f,
+            .recoveryTriggerPeriod = 0,
+    };
+    ahrs->initialising = true;
+    FusionAhrsFixedSetSettings(ahrs, &settings, deltaTime);
+    FusionAhrsFixedReset(ahrs);
+}
+
+/**
+ * @brief Resets the AHRS algorithm while maintaining the current settings.
+ * @param ahrs AHRS algorithm structure.
+ */
+void FusionAhrsFixedReset(FusionAhrsFixed *const ahrs) {
+    ahrs->quaternion = FUSION_FIXED_IDENTITY_QUATERNION;
+    ahrs->accelerometer = FUSION_FIXED_VECTOR_ZERO;
+    ahrs->initialising = true;
+    ahrs->rampedGainScale = ahrs->settings.initialGainScale;
+    ahrs->angularRateRecovery = false;
+    ahrs->halfAccelerometerFeedback = FUSION_FIXED_VECTOR_ZERO;
+    ahrs->accelerometerIgnored = false;
+    ahrs->accelerationRecoveryTrigger = 0;
+    ahrs->accelerationRecoveryTimeout = ahrs->settings.recoveryTriggerPeriod;
+}
+
+/**
+ * @brief Sets the AHRS algorithm settings.  The magnetic rejection is not
+ * used.
+ * @param ahrs AHRS algorithm structure.
+ * @param settings Settings.
+ * @param deltaTime Delta time between samples in seconds.
+ */
+void FusionAhrsFixedSetSettings(FusionAhrsFixed *const ahrs, const FusionAhrsSettings *const settings, const float deltaTime) {
+    ahrs->settings.convention = settings->convention;
+    ahrs->settings.gyroscopeRange = settings->gyroscopeRange == 0.0f ? INT32_MAX : (int32_t) ToFixed(0.98 * settings->gyroscopeRange, 16);
+    ahrs->settings.accelerationRejection = settings->accelerationRejection == 0.0f ? INT64_MAX : ToFixed(powf(0.5f * sinf(FusionDegreesToRadians(settings->accelerationRejection)), 2), 60);
+    ahrs->settings.recoveryTriggerPeriod = (int) settings->recoveryTriggerPeriod;
+    ahrs->settings.gyroscopeScale = ToFixed(FusionDegreesToRadians(0.5f) * (double) deltaTime, 46);
+    ahrs->settings.gainScale = ToFixed((double) settings->gain * deltaTime, 32);
+    ahrs->settings.gainScaleStep = ToFixed((INITIAL_GAIN - settings->gain) / INITIALISATION_PERIOD * (double) deltaTime * deltaTime, 32);
+    ahrs->settings.initialGainScale = ToFixed(INITIAL_GAIN * (double) deltaTime, 32);
+    ahrs->accelerationRecoveryTimeout = ahrs->settings.recoveryTriggerPeriod;
+    if ((settings->gain == 0.0f) || (settings->recoveryTriggerPeriod == 0)) { // disable acceleration rejection if gain is zero
+        ahrs->settings.accelerationRejection = INT64_MAX;
+    }
+    if (ahrs->initialising == false) {
+        ahrs->rampedGainScale = ahrs->settings.gainScale;
+    }
+}
+
+/**
+ * @brief Updates the AHRS algorithm using the gyroscope and accelerometer
+ * measurements only.
+ * @param ahrs AHRS algorithm structure.
+ * @param gyroscope Gyroscope measurement in Q16 degrees per second.
+ * @param accelerometer Accelerometer measurement in Q16 g.
+ */
+void FusionAhrsFixedUpdateNoMagnetometer(FusionAhrsFixed *const ahrs, const FusionFixedVector gyroscope, const FusionFixedVector accelerometer) {
+
+    // Store accelerometer
+    ahrs->accelerometer = accelerometer;
+
+    // Reinitialise if gyroscope range exceeded
+    if ((abs(gyroscope.axis.x) > ahrs->settings.gyroscopeRange) || (abs(gyroscope.axis.y) > ahrs->settings.gyroscopeRange) || (abs(gyroscope.axis.z) > ahrs->settings.gyroscopeRange)) {
+        const FusionFixedQuaternion quaternion = ahrs->quaternion;
+        FusionAhrsFixedReset(ahrs);
+        ahrs->quaternion = quaternion;
+        ahrs->angularRateRecovery = true;
+    }
+
+    // Ramp down gain during initialisation
+    if (ahrs->initialising) {
+        ahrs->rampedGainScale -= ahrs->settings.gainScaleStep;
+        if ((ahrs->rampedGainScale < ahrs->settings.gainScale) || (ahrs->settings.gainScale == 0)) {
+            ahrs->rampedGainScale = ahrs->settings.gainScale;
+            ahrs->initialising = false;
+            ahrs->angularRateRecovery = false;
+        }
+    }
+
+    // Calculate direction of gravity indicated by algorithm
+    const FusionFixedVector halfGravity = HalfGravity(ahrs);
+
+    // Calculate accelerometer feedback
+    FusionFixedVector halfAccelerometerFeedback = FUSION_FIXED_VECTOR_ZERO;
+    ahrs->accelerometerIgnored = true;
+    if (FusionFixedVectorIsZero(accelerometer) == false) {
+
+        // Calculate accelerometer feedback scaled by 0.5
+        ahrs->halfAccelerometerFeedback = Feedback(FusionFixedVectorNormalise(accelerometer), halfGravity);
+
+        // Don't ignore accelerometer if acceleration error below threshold
+        if (ahrs->initialising || ((int64_t) FusionFixedVectorMagnitudeSquared(ahrs->halfAccelerometerFeedback) <= ahrs->settings.accelerationRejection)) {
+            ahrs->accelerometerIgnored = false;
+            ahrs->accelerationRecoveryTrigger -= 9;
+        } else {
+            ahrs->accelerationRecoveryTrigger += 1;
+        }
+
+        // Don't ignore accelerometer during acceleration recovery
+        if (ahrs->accelerationRecoveryTrigger > ahrs->accelerationRecoveryTimeout) {
+            ahrs->accelerationRecoveryTimeout = 0;
+            ahrs->accelerometerIgnored = false;
+        } else {
+            ahrs->accelerationRecoveryTimeout = ahrs->settings.recoveryTriggerPeriod;
+        }
+        ahrs->accelerationRecoveryTrigger = Clamp(ahrs->accelerationRecoveryTrigger, 0, ahrs->settings.recoveryTriggerPeriod);
+
+        // Apply accelerometer feedback
+        if (ahrs->accelerometerIgnored == false) {
+            halfAccelerometerFeedback = ahrs->halfAccelerometerFeedback;
+        }
+    }
+
+    // Half rotation over the sample in radians, gyroscope plus feedback
+    const FusionFixedVector halfRotation = {.axis = {
+            .x = FusionFixedScale(gyroscope.axis.x, ahrs->settings.gyroscopeScale) + FusionFixedScale(halfAccelerometerFeedback.axis.x, ahrs->rampedGainScale),
+            .y = FusionFixedScale(gyroscope.axis.y, ahrs->settings.gyroscopeScale) + FusionFixedScale(halfAccelerometerFeedback.axis.y, ahrs->rampedGainScale),
+            .z = FusionFixedScale(gyroscope.axis.z, ahrs->settings.gyroscopeScale) + FusionFixedScale(halfAccelerometerFeedback.axis.z, ahrs->rampedGainScale),
+    }};
+
+    // Integrate rate of change of quaternion and normalise
+    ahrs->quaternion = FusionFixedQuaternionNormalise(FusionFixedQuaternionIntegrate(ahrs->quaternion, halfRotation));
+
+    // Zero heading during initialisation
+    if (ahrs->initialising) {
+        ZeroHeading(ahrs);
+    }
+}
+
+/**
+ * @brief Returns the direction of gravity scaled by 0.5, in Q30.
+ * @param ahrs AHRS algorithm structure.
+ * @return Direction of gravity scaled by 0.5.
+ */
+static inline FusionFixedVector HalfGravity(const FusionAhrsFixed *const ahrs) {
+#define Q ahrs->quaternion.element
+    const FusionFixedVector halfGravity = {.axis = {
+            .x = (int32_t) FusionFixedRound((int64_t) Q.x * Q.z - (int64_t) Q.w * Q.y, 30),
+            .y = (int32_t) FusionFixedRound((int64_t) Q.y * Q.z + (int64_t) Q.w * Q.x, 30),
+            .z = (int32_t) FusionFixedRound((int64_t) Q.w * Q.w + (int64_t) Q.z * Q.z, 30) - FUSION_Q30_ONE / 2,
+    }}; // third column of transposed rotation matrix scaled by 0.5
+    if (ahrs->settings.convention == FusionConventionNed) {
+        const FusionFixedVector negated = {.axis = {.x = -halfGravity.axis.x, .y = -halfGravity.axis.y, .z = -halfGravity.axis.z}};
+        return negated;
+    }
+    return halfGravity;
+#undef Q
+}
+
+/**
+ * @brief Returns the feedback.
+ * @param sensor Sensor, Q30.
+ * @param reference Reference, Q30.
+ * @return Feedback, Q30.
+ */
+static inline FusionFixedVector Feedback(const FusionFixedVector sensor, const FusionFixedVector reference) {
+    if (FusionFixedVectorDotProduct(sensor, reference) < 0) { // if error is >90 degrees
+        return FusionFixedVectorNormalise(FusionFixedVectorCrossProduct(sensor, reference));
+    }
+    return FusionFixedVectorCrossProduct(sensor, reference);
+}
+
+/**
+ * @brief Returns a value limited to maximum and minimum.
+ * @param value Value.
+ * @param min Minimum value.
+ * @param max Maximum value.
+ * @return Value limited to maximum and minimum.
+ */
+static inline int Clamp(const int value, const int min, const int max) {
+    if (value < min) {
+        return min;
+    }
+    if (value > max) {
+        return max;
+    }
+    return value;
+}
+
+/**
+ * @brief Converts a setting to fixed point.
+ * @param value Value.
+ * @param fractionalBits Fractional bits of the result.
+ * @return Fixed-point value.
+ */
+static inline int64_t ToFixed(const double value, const int fractionalBits) {
+    return (int64_t) llround(ldexp(value, fractionalBits));
+}
+
+/**
+ * @brief Rotates the orientation around the Earth Z axis to a heading of
+ * zero, as FusionAhrsSetHeading(ahrs, 0.0f).  The half angle rotation is
+ * found from the cosine of the heading with square roots, without trigonometry.
+ * @param ahrs AHRS algorithm structure.
+ */
+static void ZeroHeading(FusionAhrsFixed *const ahrs) {
+#define Q ahrs->quaternion.element
+
+    // Heading as the angle of (b, a), atan2(a, b)
+    const int64_t a = (int64_t) Q.w * Q.z + (int64_t) Q.x * Q.y; // Q60
+    const int64_t b = ((int64_t) FUSION_Q30_ONE << 29) - (int64_t) Q.y * Q.y - (int64_t) Q.z * Q.z; // Q60
+    const int32_t a30 = (int32_t) FusionFixedRound(a, 30);
+    const int32_t b30 = (int32_t) FusionFixedRound(b, 30);
+    const uint32_t radius = FusionFixedSqrt((uint64_t) ((int64_t) a30 * a30 + (int64_t) b30 * b30)); // Q30
+    if (radius == 0) {
+        return;
+    }
+    const int64_t cosine = ((int64_t) b30 << 30) / radius; // Q30
+
+    // Half angle cosine and sine, from the cosine of the heading
+    const uint32_t halfCosine = FusionFixedSqrt((uint64_t) ((FUSION_Q30_ONE + cosine) / 2) << 30);
+    uint32_t halfSine = FusionFixedSqrt((uint64_t) ((FUSION_Q30_ONE - cosine) / 2) << 30);
+    const int32_t c = (int32_t) halfCosine;
+    const int32_t s = a30 < 0 ? -(int32_t) halfSine : (int32_t) halfSine;
+
+    // Rotation (c, 0, 0, -s) multiplied by the quaternion
+    const FusionFixedQuaternion quaternion = {.element = {
+            .w = (int32_t) FusionFixedRound((int64_t) c * Q.w + (int64_t) s * Q.z, 30),
+            .x = (int32_t) FusionFixedRound((int64_t) c * Q.x + (int64_t) s * Q.y, 30),
+            .y = (int32_t) FusionFixedRound((int64_t) c * Q.y - (int64_t) s * Q.x, 30),
+            .z = (int32_t) FusionFixedRound((int64_t) c * Q.z - (int64_t) s * Q.w, 30),
+    }};
+    ahrs->quaternion = quaternion;
+#undef Q
+}
+
+/**
+ * @brief Returns the quaternion describing the sensor relative to the Earth.
+ * @param ahrs AHRS algorithm structure.
+ * @return Quaternion in Q30.
+ */
+FusionFixedQuaternion FusionAhrsFixedGetQuaternion(const FusionAhrsFixed *const ahrs) {
+    return ahrs->quaternion;
+}
+
+/**
+ * @brief Returns the linear acceleration measurement equal to the accelerometer
+ * measurement with the 1 g of gravity removed.
+ * @param ahrs AHRS algorithm structure.
+ * @return Linear acceleration measurement in Q16 g.
+ */
+FusionFixedVector FusionAhrsFixedGetLinearAcceleration(const FusionAhrsFixed *const ahrs) {
+
+    // Gravity in the sensor coordinate frame, twice the half gravity, Q16
+    FusionFixedVector halfGravity = HalfGravity(ahrs);
+    FusionFixedVector linearAcceleration;
+    for (int index = 0; index < 3; index++) {
+        linearAcceleration.array[index] = ahrs->accelerometer.array[index] - (int32_t) FusionFixedRound((int64_t) halfGravity.array[index], 13);
+    }
+    return linearAcceleration;
+}
+
+/**
+ * @brief Returns the AHRS algorithm flags.
+ * @param ahrs AHRS algorithm structure.
+ * @return AHRS algorithm flags.
+ */
+FusionAhrsFlags FusionAhrsFixedGetFlags(const FusionAhrsFixed *const ahrs) {
+    const FusionAhrsFlags flags = {
+            .initialising = ahrs->initialising,
+            .angularRateRecovery = ahrs->angularRateRecovery,
+            .accelerationRecovery = ahrs->accelerationRecoveryTrigger > ahrs->accelerationRecoveryTimeout,
+            .magneticRecovery = false,
+    };
+    return flags;
+}
+
+//------------------------------------------------------------------------------
+// End of file
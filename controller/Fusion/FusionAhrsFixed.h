@@ -0,0 +1,91 @@
+/**
+ * @file FusionAhrsFixed.h
+ * @brief Fixed-point build of the AHRS algorithm without magnetometer, for
+ * targets without an FPU and for results that are bit exact between host
+ * and device.
+ *
+ * The update follows FusionAhrsUpdateNoMagnetometer step for step (gain
+ * ramp and heading zeroing during initialisation, acceleration rejection
+ * and recovery, gyroscope range reinitialisation) with integer arithmetic
+ * only; see FusionFixed.h for the number formats.  The sample rate is fixed
+ * when the settings are set, the constants derived from it and from the
+ * settings are the only values calculated in float.
+ *
+ * Error against FusionAhrsUpdateNoMagnetometer built with
+ * FUSION_USE_NORMAL_SQRT, on the still, wave, shake and spin traces of the
+ * blockbash-fixed-bench host harness at 416 Hz: orientations within 0.04
+ * degrees (0.002 degrees on average) and linear accelerations within 1 mg.
+ * Q30 quaternions resolve 1e-9, finer than float, the error is mostly the
+ * float one.  Against the default float build the differences are those of
+ * its fast inverse square root, up to 0.5 degrees and 8 mg.
+ *
+ * The outputs only depend on the inputs and the settings, the same on any
+ * target, as long as the float settings constants come out the same.
+ */
+
+#ifndef FUSION_AHRS_FIXED_H
+#define FUSION_AHRS_FIXED_H
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "FusionAhrs.h"
+#include "FusionFixed.h"
+#include <stdbool.h>
+
+//------------------------------------------------------------------------------
+// Definitions
+
+/**
+ * @brief Fixed-point AHRS algorithm settings, derived from
+ * FusionAhrsSettings and the sample rate.
+ */
+typedef struct {
+    FusionConvention convention;
+    int32_t gyroscopeRange; // Q16 degrees per second
+    int64_t accelerationRejection; // Q60
+    int recoveryTriggerPeriod;
+    int64_t gyroscopeScale; // Q16 degrees per second to Q30 half radians per sample, in Q46
+    int64_t gainScale; // gain multiplied by delta time, Q32
+    int64_t gainScaleStep; // gain scale ramp per sample during initialisation, Q32
+    int64_t initialGainScale; // gain scale at the start of the initialisation, Q32
+} FusionAhrsFixedSettings;
+
+/**
+ * @brief Fixed-point AHRS algorithm structure.  Structure members are used
+ * internally and must not be accessed by the application.
+ */
+typedef struct {
+    FusionAhrsFixedSettings settings;
+    FusionFixedQuaternion quaternion;
+    FusionFixedVector accelerometer; // Q16
+    bool initialising;
+    int64_t rampedGainScale; // Q32
+    bool angularRateRecovery;
+    FusionFixedVector halfAccelerometerFeedback; // Q30
+    bool accelerometerIgnored;
+    int accelerationRecoveryTrigger;
+    int accelerationRecoveryTimeout;
+} FusionAhrsFixed;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void FusionAhrsFixedInitialise(FusionAhrsFixed *const ahrs, const float deltaTime);
+
+void FusionAhrsFixedReset(FusionAhrsFixed *const ahrs);
+
+void FusionAhrsFixedSetSettings(FusionAhrsFixed *const ahrs, const FusionAhrsSettings *const settings, const float deltaTime);
+
+void FusionAhrsFixedUpdateNoMagnetometer(FusionAhrsFixed *const ahrs, const FusionFixedVector gyroscope, const FusionFixedVector accelerometer);
+
+FusionFixedQuaternion FusionAhrsFixedGetQuaternion(const FusionAhrsFixed *const ahrs);
+
+FusionFixedVector FusionAhrsFixedGetLinearAcceleration(const FusionAhrsFixed *const ahrs);
+
+FusionAhrsFlags FusionAhrsFixedGetFlags(const FusionAhrsFixed *const ahrs);
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,329 @@
+/**
+ * @file FusionFixed.h
+ * @brief Fixed-point math library, the integer counterpart of FusionMath.h
+ * for FusionAhrsFixed.
+ *
+ * Sensor measurements are Q16 (16 fractional bits, degrees per second and
+ * g up to +/-32768).  Unit vectors and quaternions are Q30 (30 fractional
+ * bits, +/-2 range, so one is exact and sums of two unit terms cannot
+ * overflow).  Products are computed in 64 bits and rounded to nearest.
+ * Right shifts of negative values are assumed to be arithmetic, as with
+ * GCC on Arm and x86.
+ */
+
+#ifndef FUSION_FIXED_H
+#define FUSION_FIXED_H
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "FusionMath.h"
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// Definitions
+
+/**
+ * @brief One in Q16 and Q30.
+ */
+#define FUSION_Q16_ONE (INT32_C(1) << 16)
+#define FUSION_Q30_ONE (INT32_C(1) << 30)
+
+/**
+ * @brief 3D vector, in Q16 or Q30.
+ */
+typedef union {
+    int32_t array[3];
+
+    struct {
+        int32_t x;
+        int32_t y;
+        int32_t z;
+    } axis;
+} FusionFixedVector;
+
+/**
+ * @brief Quaternion in Q30.
+ */
+typedef union {
+    int32_t array[4];
+
+    struct {
+        int32_t w;
+        int32_t x;
+        int32_t y;
+        int32_t z;
+    } element;
+} FusionFixedQuaternion;
+
+/**
+ * @brief Vector of zeros.
+ */
+#define FUSION_FIXED_VECTOR_ZERO ((FusionFixedVector){ .array = {0, 0, 0} })
+
+/**
+ * @brief Identity quaternion.
+ */
+#define FUSION_FIXED_IDENTITY_QUATERNION ((FusionFixedQuaternion){ .array = {FUSION_Q30_ONE, 0, 0, 0} })
+
+//------------------------------------------------------------------------------
+// Inline functions - Arithmetic
+
+/**
+ * @brief Shifts right, rounding to nearest.
+ * @param value Value.
+ * @param shift Shift, at least 1.
+ * @return Rounded value.
+ */
+static inline int64_t FusionFixedRound(const int64_t value, const int shift) {
+    return (value + (INT64_C(1) << (shift - 1))) >> shift;
+}
+
+/**
+ * @brief Multiplies two Q30 values.
+ * @param a A.
+ * @param b B.
+ * @return A multiplied by B in Q30.
+ */
+static inline int32_t FusionQ30Multiply(const int32_t a, const int32_t b) {
+    return (int32_t) FusionFixedRound((int64_t) a * b, 30);
+}
+
+/**
+ * @brief Multiplies a value by a Q32 scale.
+ * @param value Value.
+ * @param scale Scale in Q32.
+ * @return Value multiplied by the scale, in the format of the value.
+ */
+static inline int32_t FusionFixedScale(const int32_t value, const int64_t scale) {
+    return (int32_t) FusionFixedRound((int64_t) value * scale, 32);
+}
+
+/**
+ * @brief Integer square root, rounded down.
+ * @param value Value.
+ * @return Square root of the value.
+ */
+static inline uint32_t FusionFixedSqrt(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = UINT64_C(1) << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) root;
+}
+
+//------------------------------------------------------------------------------
+// Inline functions - Conversions
+
+/**
+ * @brief Converts a float vector to fixed point, saturating.
+ * @param vector Vector.
+ * @param fractionalBits Fractional bits of the result, 16 or 30.
+ * @return Fixed-point vector.
+ */
+static inline FusionFixedVector FusionFixedVectorFromFloat(const FusionVector vector, const int fractionalBits) {
+    FusionFixedVector result;
+    for (int index = 0; index < 3; index++) {
+        const float scaled = vector.array[index] * (float) (INT64_C(1) << fractionalBits);
+        result.array[index] = scaled >= 2147483647.0f ? INT32_MAX : scaled <= -2147483648.0f ? INT32_MIN : (int32_t) lrintf(scaled);
+    }
+    return result;
+}
+
+/**
+ * @brief Converts a fixed-point vector to float.
+ * @param vector Vector.
+ * @param fractionalBits Fractional bits of the vector.
+ * @return Float vector.
+ */
+static inline FusionVector FusionFixedVectorToFloat(const FusionFixedVector vector, const int fractionalBits) {
+    const float scale = 1.0f / (float) (INT64_C(1) << fractionalBits);
+    const FusionVector result = {.axis = {
+            .x = (float) vector.axis.x * scale,
+            .y = (float) vector.axis.y * scale,
+            .z = (float) vector.axis.z * scale,
+    }};
+    return result;
+}
+
+/**
+ * @brief Converts a Q30 quaternion to float.
+ * @param quaternion Quaternion.
+ * @return Float quaternion.
+ */
+static inline FusionQuaternion FusionFixedQuaternionToFloat(const FusionFixedQuaternion quaternion) {
+    const float scale = 1.0f / (float) FUSION_Q30_ONE;
+    const FusionQuaternion result = {.element = {
+            .w = (float) quaternion.element.w * scale,
+            .x = (float) quaternion.element.x * scale,
+            .y = (float) quaternion.element.y * scale,
+            .z = (float) quaternion.element.z * scale,
+    }};
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Inline functions - Vector operations
+
+/**
+ * @brief Returns true if the vector is zero.
+ * @param vector Vector.
+ * @return True if the vector is zero.
+ */
+static inline bool FusionFixedVectorIsZero(const FusionFixedVector vector) {
+    return (vector.axis.x == 0) && (vector.axis.y == 0) && (vector.axis.z == 0);
+}
+
+/**
+ * @brief Returns the cross product of two Q30 vectors.
+ * @param vectorA Vector A.
+ * @param vectorB Vector B.
+ * @return Cross product in Q30.
+ */
+static inline FusionFixedVector FusionFixedVectorCrossProduct(const FusionFixedVector vectorA, const FusionFixedVector vectorB) {
+#define A vectorA.axis
+#define B vectorB.axis
+    const FusionFixedVector result = {.axis = {
+            .x = (int32_t) FusionFixedRound((int64_t) A.y * B.z - (int64_t) A.z * B.y, 30),
+            .y = (int32_t) FusionFixedRound((int64_t) A.z * B.x - (int64_t) A.x * B.z, 30),
+            .z = (int32_t) FusionFixedRound((int64_t) A.x * B.y - (int64_t) A.y * B.x, 30),
+    }};
+    return result;
+#undef A
+#undef B
+}
+
+/**
+ * @brief Returns the dot product of two vectors, unscaled: in Q60 for two
+ * Q30 vectors.
+ * @param vectorA Vector A.
+ * @param vectorB Vector B.
+ * @return Dot product.
+ */
+static inline int64_t FusionFixedVectorDotProduct(const FusionFixedVector vectorA, const FusionFixedVector vectorB) {
+    return (int64_t) vectorA.axis.x * vectorB.axis.x + (int64_t) vectorA.axis.y * vectorB.axis.y + (int64_t) vectorA.axis.z * vectorB.axis.z;
+}
+
+/**
+ * @brief Returns the vector magnitude squared, unscaled: in Q60 for a Q30
+ * vector, in Q32 for a Q16 vector.
+ * @param vector Vector.
+ * @return Vector magnitude squared.
+ */
+static inline uint64_t FusionFixedVectorMagnitudeSquared(const FusionFixedVector vector) {
+    return (uint64_t) FusionFixedVectorDotProduct(vector, vector);
+}
+
+/**
+ * @brief Returns the normalised vector, in Q30 whatever the format of the
+ * vector.  A zero vector is returned as is.
+ * @param vector Vector, with a magnitude below 2^31 units.
+ * @return Normalised vector in Q30.
+ */
+static inline FusionFixedVector FusionFixedVectorNormalise(const FusionFixedVector vector) {
+    const uint32_t magnitude = FusionFixedSqrt(FusionFixedVectorMagnitudeSquared(vector));
+    if (magnitude == 0) {
+        return vector;
+    }
+    // the magnitude is in the format of the vector and its reciprocal in
+    // Q60 over that format, so their product is in Q60
+    const int64_t magnitudeReciprocal = (int64_t) ((UINT64_C(1) << 60) / magnitude);
+    FusionFixedVector result;
+    for (int index = 0; index < 3; index++) {
+        result.array[index] = (int32_t) FusionFixedRound((int64_t) vector.array[index] * magnitudeReciprocal, 30);
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Inline functions - Quaternion operations
+
+/**
+ * @brief Multiplies two Q30 quaternions.
+ * @param quaternionA Quaternion A (to be post-multiplied).
+ * @param quaternionB Quaternion B (to be pre-multiplied).
+ * @return Quaternion A multiplied by quaternion B.
+ */
+static inline FusionFixedQuaternion FusionFixedQuaternionMultiply(const FusionFixedQuaternion quaternionA, const FusionFixedQuaternion quaternionB) {
+#define A quaternionA.element
+#define B quaternionB.element
+    const FusionFixedQuaternion result = {.element = {
+            .w = (int32_t) FusionFixedRound((int64_t) A.w * B.w - (int64_t) A.x * B.x - (int64_t) A.y * B.y - (int64_t) A.z * B.z, 30),
+            .x = (int32_t) FusionFixedRound((int64_t) A.w * B.x + (int64_t) A.x * B.w + (int64_t) A.y * B.z - (int64_t) A.z * B.y, 30),
+            .y = (int32_t) FusionFixedRound((int64_t) A.w * B.y - (int64_t) A.x * B.z + (int64_t) A.y * B.w + (int64_t) A.z * B.x, 30),
+            .z = (int32_t) FusionFixedRound((int64_t) A.w * B.z + (int64_t) A.x * B.y - (int64_t) A.y * B.x + (int64_t) A.z * B.w, 30),
+    }};
+    return result;
+#undef A
+#undef B
+}
+
+/**
+ * @brief Adds the rate of change of a Q30 quaternion for a Q30 vector
+ * rotation, the integration step of the AHRS.
+ * @param quaternion Quaternion.
+ * @param vector Half rotation over the step, in radians.
+ * @return Integrated quaternion, not normalised.
+ */
+static inline FusionFixedQuaternion FusionFixedQuaternionIntegrate(const FusionFixedQuaternion quaternion, const FusionFixedVector vector) {
+#define Q quaternion.element
+#define V vector.axis
+    const FusionFixedQuaternion result = {.element = {
+            .w = Q.w + (int32_t) FusionFixedRound(-(int64_t) Q.x * V.x - (int64_t) Q.y * V.y - (int64_t) Q.z * V.z, 30),
+            .x = Q.x + (int32_t) FusionFixedRound((int64_t) Q.w * V.x + (int64_t) Q.y * V.z - (int64_t) Q.z * V.y, 30),
+            .y = Q.y + (int32_t) FusionFixedRound((int64_t) Q.w * V.y - (int64_t) Q.x * V.z + (int64_t) Q.z * V.x, 30),
+            .z = Q.z + (int32_t) FusionFixedRound((int64_t) Q.w * V.z + (int64_t) Q.x * V.y - (int64_t) Q.y * V.x, 30),
+    }};
+    return result;
+#undef Q
+#undef V
+}
+
+/**
+ * @brief Normalises a Q30 quaternion.  Within 1/256 of unit magnitude, as
+ * after an integration step, two Newton iterations of the reciprocal square
+ * root from one, exact to the last bit there; otherwise an integer square
+ * root and a division.
+ * @param quaternion Quaternion.
+ * @return Normalised quaternion.
+ */
+static inline FusionFixedQuaternion FusionFixedQuaternionNormalise(const FusionFixedQuaternion quaternion) {
+#define Q quaternion.element
+    const uint64_t magnitudeSquared = (uint64_t) ((int64_t) Q.w * Q.w + (int64_t) Q.x * Q.x + (int64_t) Q.y * Q.y + (int64_t) Q.z * Q.z);
+    const int32_t magnitudeSquaredQ30 = (int32_t) FusionFixedRound((int64_t) magnitudeSquared, 30);
+    int64_t magnitudeReciprocal; // Q30
+    if ((magnitudeSquaredQ30 > FUSION_Q30_ONE - FUSION_Q30_ONE / 256) && (magnitudeSquaredQ30 < FUSION_Q30_ONE + FUSION_Q30_ONE / 256)) {
+        const int64_t three = 3 * (int64_t) FUSION_Q30_ONE;
+        const int32_t y = (int32_t) ((three - magnitudeSquaredQ30) / 2);
+        magnitudeReciprocal = FusionFixedRound((int64_t) y * (three - FusionQ30Multiply(magnitudeSquaredQ30, FusionQ30Multiply(y, y))), 31);
+    } else {
+        const uint32_t magnitude = FusionFixedSqrt(magnitudeSquared);
+        if (magnitude == 0) {
+            return FUSION_FIXED_IDENTITY_QUATERNION;
+        }
+        magnitudeReciprocal = (int64_t) ((UINT64_C(1) << 60) / magnitude);
+    }
+    const FusionFixedQuaternion result = {.element = {
+            .w = (int32_t) FusionFixedRound(Q.w * magnitudeReciprocal, 30),
+            .x = (int32_t) FusionFixedRound(Q.x * magnitudeReciprocal, 30),
+            .y = (int32_t) FusionFixedRound(Q.y * magnitudeReciprocal, 30),
+            .z = (int32_t) FusionFixedRound(Q.z * magnitudeReciprocal, 30),
+    }};
+    return result;
+#undef Q
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -10,7 +10,7 @@
 //------------------------------------------------------------------------------
 // Includes
 
-#include <math.h> // M_PI, sqrtf, atan2f, asinf
+#include <math.h> // M_PI, sqrtf, atan2f, asinf, fabsf
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -110,12 +110,55 @@ typedef union {
 #define M_PI (3.14159265358979323846)
 #endif
 
+/**
+ * @brief Inverse square root policies of FusionInverseSqrt, for
+ * FUSION_INVERSE_SQRT.
+ * - FUSION_INVERSE_SQRT_BIT_HACK: FusionFastInverseSqrt, an integer
+ *   estimate and one tuned Newton step.
+ * - FUSION_INVERSE_SQRT_HARDWARE: 1.0f / sqrtf, VSQRT and VDIV on an FPU
+ *   with a single precision square root, such as the Cortex-M4F, when built
+ *   with -fno-math-errno.
+ * - FUSION_INVERSE_SQRT_NEWTON: the integer estimate and two Newton steps,
+ *   with multiplies only.
+ */
+#define FUSION_INVERSE_SQRT_BIT_HACK (0)
+#define FUSION_INVERSE_SQRT_HARDWARE (1)
+#define FUSION_INVERSE_SQRT_NEWTON (2)
+
 /**
  * @brief Include this definition or add as a preprocessor definition to use
- * normal square root operations.
+ * normal square root operations, the same as FUSION_INVERSE_SQRT_HARDWARE.
  */
 //#define FUSION_USE_NORMAL_SQRT
 
+/**
+ * @brief Include this definition or add as a preprocessor definition to
+ * select the inverse square root of FusionVectorNormalise and
+ * FusionQuaternionNormalise.  The bit hack by default.
+ */
+#ifndef FUSION_INVERSE_SQRT
+#ifdef FUSION_USE_NORMAL_SQRT
+#define FUSION_INVERSE_SQRT FUSION_INVERSE_SQRT_HARDWARE
+#else
+#define FUSION_INVERSE_SQRT FUSION_INVERSE_SQRT_BIT_HACK
+#endif
+#endif
+
+/**
+ * @brief Include this definition or add as a preprocessor definition to
+ * replace the atan2f and asinf of FusionQuaternionToEuler with polynomial
+ * approximations, for a largest arc tangent error in microdegrees of at
+ * least 120.  The shortest polynomial within that error is used:
+ * - 300000 (0.3 degrees), 2 terms
+ * - 40000 (0.04 degrees), 3 terms
+ * - 5000 (0.005 degrees), 4 terms
+ * - 700 (0.0007 degrees), 5 terms
+ * - 120 (0.00012 degrees), 6 terms
+ * The Euler angles also carry the rounding of the float arguments, about
+ * 0.0002 degrees as with atan2f.
+ */
+//#define FUSION_FAST_EULER_MAX_ERROR 5000
+
 //------------------------------------------------------------------------------
 // Inline functions - Degrees and radians conversion
 
@@ -156,9 +199,75 @@ static inline float FusionAsin(const float value) {
 }
 
 //------------------------------------------------------------------------------
-// Inline functions - Fast inverse square root
+// Inline functions - Fast arc tangent
+
+#ifdef FUSION_FAST_EULER_MAX_ERROR
+
+/**
+ * @brief Returns the arc tangent of a ratio between 0 and 1 in degrees, from
+ * an odd minimax polynomial within FUSION_FAST_EULER_MAX_ERROR microdegrees.
+ * @param ratio Ratio between 0 and 1.
+ * @return Arc tangent of the ratio in degrees.
+ */
+static inline float FusionFastAtanDegrees(const float ratio) {
+    const float ratioSquared = ratio * ratio;
+#if FUSION_FAST_EULER_MAX_ERROR >= 300000
+    return ratio * (55.714079f - 10.9978077f * ratioSquared);
+#elif FUSION_FAST_EULER_MAX_ERROR >= 40000
+    return ratio * (57.0298099f + ratioSquared * (-16.5407322f + ratioSquared * 4.54579222f));
+#elif FUSION_FAST_EULER_MAX_ERROR >= 5000
+    return ratio * (57.2507343f + ratioSquared * (-18.4019702f + ratioSquared * (8.38033646f + ratioSquared * -2.23376272f)));
+#elif FUSION_FAST_EULER_MAX_ERROR >= 700
+    return ratio * (57.2881208f + ratioSquared * (-18.9250702f + ratioSquared * (10.3223672f + ratioSquared * (-4.87909951f + ratioSquared * 1.19433707f))));
+#elif FUSION_FAST_EULER_MAX_ERROR >= 120
+    return ratio * (57.2944743f + ratioSquared * (-19.0578842f + ratioSquared * (11.0890467f + ratioSquared * (-6.67074604f + ratioSquared * (3.01647104f + ratioSquared * -0.671457017f)))));
+#else
+#error "FUSION_FAST_EULER_MAX_ERROR is below the 120 microdegrees of the longest polynomial"
+#endif
+}
 
-#ifndef FUSION_USE_NORMAL_SQRT
+/**
+ * @brief Returns the arc tangent of y / x in degrees, in all four quadrants
+ * as atan2f.  The smaller of |y| and |x| over the larger is reduced to
+ * FusionFastAtanDegrees.
+ * @param y Y.
+ * @param x X.
+ * @return Arc tangent of y / x in degrees.
+ */
+static inline float FusionFastAtan2Degrees(const float y, const float x) {
+    const float absY = fabsf(y);
+    const float absX = fabsf(x);
+    if (absY > absX) {
+        const float angle = 90.0f - FusionFastAtanDegrees(absX / absY);
+        return y < 0.0f ? (x < 0.0f ? angle - 180.0f : -angle) : (x < 0.0f ? 180.0f - angle : angle);
+    }
+    if (absX == 0.0f) {
+        return 0.0f;
+    }
+    const float angle = FusionFastAtanDegrees(absY / absX);
+    return y < 0.0f ? (x < 0.0f ? angle - 180.0f : -angle) : (x < 0.0f ? 180.0f - angle : angle);
+}
+
+/**
+ * @brief Returns the arc sine of the value in degrees, as the arc tangent
+ * of the value over the cosine.
+ * @param value Value.
+ * @return Arc sine of the value in degrees.
+ */
+static inline float FusionFastAsinDegrees(const float value) {
+    if (value <= -1.0f) {
+        return -90.0f;
+    }
+    if (value >= 1.0f) {
+        return 90.0f;
+    }
+    return FusionFastAtan2Degrees(value, sqrtf(1.0f - value * value));
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// Inline functions - Inverse square root
 
 /**
  * @brief Calculates the reciprocal of the square root.
@@ -178,7 +287,45 @@ static inline float FusionFastInverseSqrt(const float x) {
     return union32.f * (1.69000231f - 0.714158168f * x * union32.f * union32.f);
 }
 
+/**
+ * @brief Calculates the reciprocal of the square root with two Newton steps
+ * from the integer estimate of the magic constant 0x5F375A86.
+ * See http://www.lomont.org/papers/2003/InvSqrt.pdf
+ * @param x Operand.
+ * @return Reciprocal of the square root of x.
+ */
+static inline float FusionNewtonInverseSqrt(const float x) {
+
+    typedef union {
+        float f;
+        int32_t i;
+    } Union32;
+
+    Union32 union32 = {.f = x};
+    union32.i = 0x5F375A86 - (union32.i >> 1);
+    const float halfX = 0.5f * x;
+    float y = union32.f;
+    y = y * (1.5f - halfX * y * y);
+    return y * (1.5f - halfX * y * y);
+}
+
+/**
+ * @brief Calculates the reciprocal of the square root with the policy
+ * selected by FUSION_INVERSE_SQRT.
+ * @param x Operand.
+ * @return Reciprocal of the square root of x.
+ */
+static inline float FusionInverseSqrt(const float x) {
+#if FUSION_INVERSE_SQRT == FUSION_INVERSE_SQRT_BIT_HACK
+    return FusionFastInverseSqrt(x);
+#elif FUSION_INVERSE_SQRT == FUSION_INVERSE_SQRT_HARDWARE
+    return 1.0f / sqrtf(x);
+#elif FUSION_INVERSE_SQRT == FUSION_INVERSE_SQRT_NEWTON
+    return FusionNewtonInverseSqrt(x);
+#else
+#error "FUSION_INVERSE_SQRT is not one of the FUSION_INVERSE_SQRT_ policies"
 #endif
+}
 
 //------------------------------------------------------------------------------
 // Inline functions - Vector operations
@@ -314,11 +461,7 @@ static inline float FusionVectorMagnitude(const FusionVector vector) {
  * @return Normalised vector.
  */
 static inline FusionVector FusionVectorNormalise(const FusionVector vector) {
-#ifdef FUSION_USE_NORMAL_SQRT
-    const float magnitudeReciprocal = 1.0f / sqrtf(FusionVectorMagnitudeSquared(vector));
-#else
-    const float magnitudeReciprocal = FusionFastInverseSqrt(FusionVectorMagnitudeSquared(vector));
-#endif
+    const float magnitudeReciprocal = FusionInverseSqrt(FusionVectorMagnitudeSquared(vector));
     return FusionVectorMultiplyScalar(vector, magnitudeReciprocal);
 }
 
@@ -391,11 +534,7 @@ static inline FusionQuaternion FusionQuaternionMultiplyVector(const FusionQuater
  */
 static inline FusionQuaternion FusionQuaternionNormalise(const FusionQuaternion quaternion) {
 #define Q quaternion.element
-#ifdef FUSION_USE_NORMAL_SQRT
-    const float magnitudeReciprocal = 1.0f / sqrtf(Q.w * Q.w + Q.x * Q.x + Q.y * Q.y + Q.z * Q.z);
-#else
-    const float magnitudeReciprocal = FusionFastInverseSqrt(Q.w * Q.w + Q.x * Q.x + Q.y * Q.y + Q.z * Q.z);
-#endif
+    const float magnitudeReciprocal = FusionInverseSqrt(Q.w * Q.w + Q.x * Q.x + Q.y * Q.y + Q.z * Q.z);
     const FusionQuaternion result = {.element = {
             .w = Q.w * magnitudeReciprocal,
             .x = Q.x * magnitudeReciprocal,
@@ -466,11 +605,19 @@ static inline FusionMatrix FusionQuaternionToMatrix(const FusionQuaternion quate
 static inline FusionEuler FusionQuaternionToEuler(const FusionQuaternion quaternion) {
 #define Q quaternion.element
     const float halfMinusQySquared = 0.5f - Q.y * Q.y; // calculate common terms to avoid repeated operations
+#ifdef FUSION_FAST_EULER_MAX_ERROR
+    const FusionEuler euler = {.angle = {
+            .roll = FusionFastAtan2Degrees(Q.w * Q.x + Q.y * Q.z, halfMinusQySquared - Q.x * Q.x),
+            .pitch = FusionFastAsinDegrees(2.0f * (Q.w * Q.y - Q.z * Q.x)),
+            .yaw = FusionFastAtan2Degrees(Q.w * Q.z + Q.x * Q.y, halfMinusQySquared - Q.z * Q.z),
+    }};
+#else
     const FusionEuler euler = {.angle = {
             .roll = FusionRadiansToDegrees(atan2f(Q.w * Q.x + Q.y * Q.z, halfMinusQySquared - Q.x * Q.x)),
             .pitch = FusionRadiansToDegrees(FusionAsin(2.0f * (Q.w * Q.y - Q.z * Q.x))),
             .yaw = FusionRadiansToDegrees(atan2f(Q.w * Q.z + Q.x * Q.y, halfMinusQySquared - Q.z * Q.z)),
     }};
+#endif
     return euler;
 #undef Q
 }
@@ -6,7 +6,78 @@
 #include "stm32l475e_iot01_gyro.h"
 #include "lsm6dsl.h"
 
-int tracking = 0; // use this to start and stop tracking
+#include "sensor-data.hpp"
+
+// FIFO sampling: both sensors run at IMU_FIFO_ODR_HZ and the FIFO is
+// drained once FIFO_WATERMARK_SETS sample sets have piled up
+#define IMU_FIFO_ODR            LSM6DSL_ODR_416Hz
+#define FIFO_WORDS_PER_SET      6   // gyro x, y, z then accel x, y, z
+#define FIFO_WATERMARK_SETS     MBED_CONF_APP_IMU_FIFO_WATERMARK
+#define FIFO_MAX_SETS           (2 * FIFO_WATERMARK_SETS)
+
+// INT1_CTRL: FIFO threshold on INT1, high while the FIFO is at or above
+// the watermark
+#define INT1_CTRL_FIFO_THRESHOLD  0x08
+
+// FIFO_CTRL3: gyroscope and accelerometer both in the FIFO, no decimation
+#define FIFO_CTRL3_NO_DECIMATION  0x09
+// FIFO_CTRL5: FIFO mode in bits 2:0, FIFO rate in bits 6:3 with the same
+// codes as the sensor rates
+#define FIFO_MODE_BYPASS        0x00
+#define FIFO_MODE_CONTINUOUS    0x06
+#define FIFO_CTRL5_ODR(odr)     (((odr) >> 4) << 3)
+// FIFO_STATUS2
+#define FIFO_STATUS2_OVER_RUN   0x40
+#define FIFO_STATUS2_DIFF_MASK  0x07
+
+// Embedded functions, see AN5040
+// TAP_CFG: latched interrupts from the embedded functions, tap on all axes
+#define TAP_CFG_INTERRUPTS      0x80
+#define TAP_CFG_TAP_XYZ         0x0E
+#define TAP_CFG_LATCHED         0x01
+// TAP_THS_6D: 6D threshold 60 degrees, tap threshold 12 * 62.5 mg
+#define TAP_THS_6D_60_DEGREES   0x40
+#define TAP_THS_750_MG          0x0C
+// INT_DUR2 at 416 Hz: second tap within 4 * 77 ms, 3 * 10 ms quiet after
+// a tap, shocks up to 3 * 19 ms long
+#define INT_DUR2_DOUBLE_TAP     0x4F
+// WAKE_UP_THS: single and double tap
+#define WAKE_UP_THS_DOUBLE_TAP  0x80
+// MD1_CFG: double tap and 6D on INT1
+#define MD1_CFG_DOUBLE_TAP      0x08
+#define MD1_CFG_6D              0x04
+// CTRL8_XL: low pass filter on the 6D input
+#define CTRL8_XL_LOW_PASS_6D    0x01
+
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES && !MBED_CONF_APP_IMU_INTERRUPT
+#error "imu-embedded-gestures needs imu-interrupt"
+#endif
+
+static imu_fifo_stats fifo_stats;
+
+#if MBED_CONF_APP_IMU_INTERRUPT
+// LSM6DSL INT1 is wired to PD_11 on the B-L475E-IOT01A; INT2 is not wired,
+// so the FIFO threshold and the embedded functions share INT1
+#define IMU_INT1_PIN            PD_11
+#define IMU_FLAG_FIFO           0x1
+
+static InterruptIn imu_int1(IMU_INT1_PIN);
+static EventFlags imu_flags;
+
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES
+// when the last embedded function interrupt came
+static Timer imu_event_timer;
+static volatile uint32_t imu_event_us;
+#endif
+
+static void on_imu_int1()
+{
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES
+    imu_event_us = imu_event_timer.elapsed_time().count();
+#endif
+    imu_flags.set(IMU_FLAG_FIFO);
+}
+#endif
 
 /**
  * @brief Initialize the accelerometer and register interrupts.
@@ -50,6 +121,113 @@ void read_gyro_raw(float* pfData){
 
 
 
+static void imu_write(uint8_t reg, uint8_t value)
+{
+    SENSOR_IO_Write(LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW, reg, value);
+}
+
+static uint8_t imu_read(uint8_t reg)
+{
+    return SENSOR_IO_Read(LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW, reg);
+}
+
+/**
+ * @brief Switch both sensors to the FIFO rate, keeping the full scales set
+ * by sensors_init(), and start the FIFO in continuous mode.
+ */
+void sensors_fifo_init()
+{
+    uint8_t ctrl;
+
+    ctrl = imu_read(LSM6DSL_ACC_GYRO_CTRL1_XL);
+    imu_write(LSM6DSL_ACC_GYRO_CTRL1_XL, (ctrl & ~LSM6DSL_ODR_BITPOSITION) | IMU_FIFO_ODR);
+    ctrl = imu_read(LSM6DSL_ACC_GYRO_CTRL2_G);
+    imu_write(LSM6DSL_ACC_GYRO_CTRL2_G, (ctrl & ~LSM6DSL_ODR_BITPOSITION) | IMU_FIFO_ODR);
+
+    // watermark in 16 bit words
+    uint16_t watermark = FIFO_WATERMARK_SETS * FIFO_WORDS_PER_SET;
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL1, watermark & 0xFF);
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL2, (watermark >> 8) & 0x07);
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL3, FIFO_CTRL3_NO_DECIMATION);
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL4, 0x00);
+
+    // going through bypass empties the FIFO
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL5, FIFO_MODE_BYPASS);
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL5, FIFO_CTRL5_ODR(IMU_FIFO_ODR) | FIFO_MODE_CONTINUOUS);
+
+#if MBED_CONF_APP_IMU_INTERRUPT
+    imu_int1.rise(&on_imu_int1);
+    imu_write(LSM6DSL_ACC_GYRO_INT1_CTRL, INT1_CTRL_FIFO_THRESHOLD);
+#endif
+}
+
+/**
+ * @brief Read the complete sample sets waiting in the FIFO.
+ *
+ * The FIFO level and the position of the next word in the gyro/accel
+ * pattern come in one read of FIFO_STATUS1..4, then all the sets in one
+ * burst read of FIFO_DATA_OUT: the address rolls back from FIFO_DATA_OUT_H
+ * to FIFO_DATA_OUT_L, so consecutive bytes walk through the FIFO.
+ *
+ * @param samples room for max_samples sets, oldest first.
+ * @return the number of sets read.
+ */
+int read_imu_fifo(imu_sample *samples, int max_samples)
+{
+    uint8_t status[4];
+    SENSOR_IO_ReadMultiple(LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW,
+                           LSM6DSL_ACC_GYRO_FIFO_STATUS1, status, sizeof(status));
+
+    int words = status[0] | ((status[1] & FIFO_STATUS2_DIFF_MASK) << 8);
+    int pattern = status[2] | ((status[3] & 0x03) << 8);
+    if (status[1] & FIFO_STATUS2_OVER_RUN) {
+        fifo_stats.overruns++;
+    }
+
+    // after an overrun the FIFO may not start on a gyro x word, drop the
+    // rest of the broken set
+    if (pattern != 0) {
+        uint8_t skipped[2 * FIFO_WORDS_PER_SET];
+        int skip = FIFO_WORDS_PER_SET - pattern;
+        if (skip > words) {
+            return 0;
+        }
+        SENSOR_IO_ReadMultiple(LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW,
+                               LSM6DSL_ACC_GYRO_FIFO_DATA_OUT_L, skipped, 2 * skip);
+        words -= skip;
+        fifo_stats.realigned++;
+    }
+
+    int sets = words / FIFO_WORDS_PER_SET;
+    if (sets > max_samples) {
+        sets = max_samples;
+    }
+    if (sets == 0) {
+        return 0;
+    }
+
+    // the oldest set was sampled that long before this drain
+    uint32_t age_us = (uint32_t) (words / FIFO_WORDS_PER_SET) * 1000000 / IMU_FIFO_ODR_HZ;
+    fifo_stats.age_total_us += age_us;
+    if (age_us > fifo_stats.age_max_us) {
+        fifo_stats.age_max_us = age_us;
+    }
+
+    // the FIFO holds little endian words in the order of imu_sample
+    SENSOR_IO_ReadMultiple(LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW,
+                           LSM6DSL_ACC_GYRO_FIFO_DATA_OUT_L,
+                           (uint8_t *) samples, sets * sizeof(imu_sample));
+
+    fifo_stats.drains++;
+    fifo_stats.samples += sets;
+    return sets;
+}
+
+const imu_fifo_stats &get_imu_fifo_stats()
+{
+    return fifo_stats;
+}
+
 /**
  * @brief Read and print (to stdout) the accelerometer data. Also print the number of blocks to left moved or right moved
  */
@@ -71,26 +249,138 @@ void read_accelerometer() {
     );
 }
 
+#if MBED_CONF_APP_IMU_FIFO_REPORT
 /**
- * @brief Print (to stdout) information about the accelerometer
- * only when output_toggle is true.
+ * @brief Print (to stdout) the latest sample and the FIFO counters.
+ */
+static void print_imu_fifo(const imu_sample &sample)
+{
+    const imu_fifo_stats &stats = get_imu_fifo_stats();
+    printf("IMU %lu wakeups, oldest sample avg %lu us, max %lu us old when read\n",
+        (unsigned long) stats.wakeups,
+        (unsigned long) (stats.drains ? stats.age_total_us / stats.drains : 0),
+        (unsigned long) stats.age_max_us
+    );
+    printf("IMU (%d, %d, %d) mg (%d, %d, %d) dps; %lu samples in %lu reads, %lu overruns\n",
+        (int) (sample.accel[0] * LSM6DSL_ACC_SENSITIVITY_2G),
+        (int) (sample.accel[1] * LSM6DSL_ACC_SENSITIVITY_2G),
+        (int) (sample.accel[2] * LSM6DSL_ACC_SENSITIVITY_2G),
+        (int) (sample.gyro[0] * LSM6DSL_GYRO_SENSITIVITY_2000DPS / 1000),
+        (int) (sample.gyro[1] * LSM6DSL_GYRO_SENSITIVITY_2000DPS / 1000),
+        (int) (sample.gyro[2] * LSM6DSL_GYRO_SENSITIVITY_2000DPS / 1000),
+        (unsigned long) stats.samples, (unsigned long) stats.drains,
+        (unsigned long) stats.overruns
+    );
+}
+#endif
+
+/**
+ * @brief Sample the IMU through its FIFO, hand every batch to on_samples
+ * and, with imu-fifo-report, print (to stdout) the latest sample and the
+ * FIFO counters once a second.
  *
- * Also turn LED1 on when output_toggle is true and off otherwise.
+ * The FIFO fills at IMU_FIFO_ODR_HZ and is drained in one burst once per
+ * watermark: on the INT1 FIFO threshold interrupt with imu-interrupt,
+ * otherwise after sleeping for a watermark period. Between the two the
+ * thread is blocked and the MCU can sleep.
  *
  * This function does not return.
  */
-void start_imu_tracking()
-{   
-    DigitalOut led(LED1); 
+void start_imu_tracking(mbed::Callback<void(const imu_sample *, int)> on_samples)
+{
+    imu_sample samples[FIFO_MAX_SETS];
+#if MBED_CONF_APP_IMU_FIFO_REPORT
+    uint32_t printed_samples = 0;
+#endif
+
+    sensors_fifo_init();
     while (true) {
-        // React to (and possibly mutate) application state
-        if (output_on == 1){
-            read_accelerometer();
+#if MBED_CONF_APP_IMU_INTERRUPT
+        imu_flags.wait_any(IMU_FLAG_FIFO);
+#else
+        thread_sleep_for(FIFO_WATERMARK_SETS * 1000 / IMU_FIFO_ODR_HZ);
+#endif
+        fifo_stats.wakeups++;
+
+        int count = read_imu_fifo(samples, FIFO_MAX_SETS);
+
+#if MBED_CONF_APP_IMU_INTERRUPT
+        // still at the watermark, there will be no new edge to wait for
+        if (imu_int1.read()) {
+            imu_flags.set(IMU_FLAG_FIFO);
         }
-        if (output_on != prev_state){
-            led = !led; 
-            prev_state = output_on;
+#endif
+
+        if (count > 0) {
+            on_samples(samples, count);
+        }
+
+#if MBED_CONF_APP_IMU_FIFO_REPORT
+        uint32_t total = get_imu_fifo_stats().samples;
+        if (count > 0 && total - printed_samples >= IMU_FIFO_ODR_HZ) {
+            print_imu_fifo(samples[count - 1]);
+            printed_samples = total;
         }
-        thread_sleep_for(100);
+#endif
+    }
+}
+
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES
+/**
+ * @brief Detect double taps and 6D orientation changes in the LSM6DSL
+ * and raise INT1 on them, with the gyroscope and the FIFO off.
+ *
+ * The accelerometer stays at IMU_FIFO_ODR_HZ, tap detection needs at
+ * least 416 Hz.
+ */
+void sensors_embedded_init()
+{
+    uint8_t ctrl;
+
+    ctrl = imu_read(LSM6DSL_ACC_GYRO_CTRL1_XL);
+    imu_write(LSM6DSL_ACC_GYRO_CTRL1_XL, (ctrl & ~LSM6DSL_ODR_BITPOSITION) | IMU_FIFO_ODR);
+    ctrl = imu_read(LSM6DSL_ACC_GYRO_CTRL2_G);
+    imu_write(LSM6DSL_ACC_GYRO_CTRL2_G, ctrl & ~LSM6DSL_ODR_BITPOSITION);
+    imu_write(LSM6DSL_ACC_GYRO_FIFO_CTRL5, FIFO_MODE_BYPASS);
+
+    imu_write(LSM6DSL_ACC_GYRO_TAP_CFG1, TAP_CFG_INTERRUPTS | TAP_CFG_TAP_XYZ | TAP_CFG_LATCHED);
+    imu_write(LSM6DSL_ACC_GYRO_TAP_THS_6D, TAP_THS_6D_60_DEGREES | TAP_THS_750_MG);
+    imu_write(LSM6DSL_ACC_GYRO_INT_DUR2, INT_DUR2_DOUBLE_TAP);
+    imu_write(LSM6DSL_ACC_GYRO_WAKE_UP_THS, WAKE_UP_THS_DOUBLE_TAP);
+    ctrl = imu_read(LSM6DSL_ACC_GYRO_CTRL8_XL);
+    imu_write(LSM6DSL_ACC_GYRO_CTRL8_XL, ctrl | CTRL8_XL_LOW_PASS_6D);
+
+    imu_event_timer.start();
+    imu_int1.rise(&on_imu_int1);
+    imu_write(LSM6DSL_ACC_GYRO_INT1_CTRL, 0x00);
+    imu_write(LSM6DSL_ACC_GYRO_MD1_CFG, MD1_CFG_DOUBLE_TAP | MD1_CFG_6D);
+}
+
+/**
+ * @brief Sleep until the LSM6DSL detects a double tap or an orientation
+ * change, then hand its sources to on_events.
+ *
+ * Nothing runs on the MCU between events. Reading the sources clears the
+ * latched interrupt.
+ *
+ * This function does not return.
+ */
+void start_imu_events(mbed::Callback<void(const imu_events &)> on_events)
+{
+    sensors_embedded_init();
+    while (true) {
+        imu_flags.wait_any(IMU_FLAG_FIFO);
+
+        // WAKE_UP_SRC, TAP_SRC and D6D_SRC in one read
+        uint8_t sources[3];
+        SENSOR_IO_ReadMultiple(LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW,
+                               LSM6DSL_ACC_GYRO_WAKE_UP_SRC, sources, sizeof(sources));
+
+        imu_events events;
+        events.tap_src = sources[1];
+        events.d6d_src = sources[2];
+        events.waited_us = (uint32_t) imu_event_timer.elapsed_time().count() - imu_event_us;
+        on_events(events);
     }
 }
+#endif
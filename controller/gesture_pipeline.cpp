@@ -0,0 +1,187 @@
+#include "mbed.h"
+
+#include "gesture_pipeline.hpp"
+#include "sensor-data.hpp"
+#include "orientation_tracker.hpp"
+
+// Cycles a sample may take in the recognizer and in the orientation
+// tracker; the sample period is about 190k cycles at 80 MHz and 416 Hz,
+// the rest is left to BLE
+#define GESTURE_CYCLE_BUDGET        2000
+#define ORIENTATION_CYCLE_BUDGET    4000
+
+// Samples tracked at once ahead of the recognizer
+#define TRACKED_BATCH_LENGTH        32
+
+/**
+ * @brief Per-sample cost of a processing stage, in CPU cycles.
+ */
+struct stage_cycle_stats {
+    uint32_t samples;
+    uint32_t over_budget;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+};
+
+/**
+ * @brief How long embedded function events wait on the MCU, from INT1 to
+ * the gesture going out.
+ */
+struct gesture_event_stats {
+    uint32_t interrupts;
+    uint32_t gestures;
+    uint64_t latency_total_us;
+    uint32_t latency_max_us;
+};
+
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES
+static gesture_event_stats event_stats;
+#else
+static GestureRecognizer recognizer;
+static stage_cycle_stats gesture_cycles;
+#if MBED_CONF_APP_IMU_ORIENTATION
+static OrientationTracker orientation;
+static stage_cycle_stats orientation_cycles;
+#endif
+#endif
+
+// Where recognized gestures go, set by run_gesture_pipeline()
+static mbed::Callback<void(const gesture &)> send_gesture;
+
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES
+/**
+ * @brief Turn an embedded function interrupt into gestures, on the sensor
+ * thread.
+ */
+static void on_imu_events(const imu_events &events)
+{
+    gesture recognized[2];
+    int count = map_imu_events(events, recognized);
+    for (int i = 0; i < count; i++) {
+        send_gesture(recognized[i]);
+    }
+
+    event_stats.interrupts++;
+    event_stats.gestures += count;
+    event_stats.latency_total_us += events.waited_us;
+    if (events.waited_us > event_stats.latency_max_us) {
+        event_stats.latency_max_us = events.waited_us;
+    }
+#if MBED_CONF_APP_IMU_GESTURE_REPORT
+    if (count > 0) {
+        printf("GESTURE %lu interrupts, %lu gestures, avg %lu max %lu us from INT1\n",
+            (unsigned long) event_stats.interrupts, (unsigned long) event_stats.gestures,
+            (unsigned long) (event_stats.latency_total_us / event_stats.interrupts),
+            (unsigned long) event_stats.latency_max_us
+        );
+    }
+#endif
+}
+#else
+/**
+ * @brief Start the DWT cycle counter, used to time the recognizer.
+ */
+static void cycle_counter_init()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static void count_cycles(stage_cycle_stats &stats, uint32_t cycles, uint32_t budget)
+{
+    stats.samples++;
+    stats.total_cycles += cycles;
+    if (cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+    if (cycles > budget) {
+        stats.over_budget++;
+    }
+}
+
+#if MBED_CONF_APP_IMU_GESTURE_REPORT
+static void print_cycles(const char *stage, const stage_cycle_stats &stats, uint32_t budget)
+{
+    printf("%s %lu samples, avg %lu max %lu cycles, %lu over %lu\n", stage,
+        (unsigned long) stats.samples,
+        (unsigned long) (stats.samples ? stats.total_cycles / stats.samples : 0),
+        (unsigned long) stats.max_cycles,
+        (unsigned long) stats.over_budget, (unsigned long) budget
+    );
+}
+#endif
+
+/**
+ * @brief Run samples through the recognizer and send what it recognizes.
+ */
+static void recognize_samples(const imu_sample *samples, int count)
+{
+    for (int i = 0; i < count; i++) {
+        gesture recognized;
+
+        uint32_t start = DWT->CYCCNT;
+        bool found = recognizer.add_sample(samples[i], recognized);
+        count_cycles(gesture_cycles, DWT->CYCCNT - start, GESTURE_CYCLE_BUDGET);
+
+        if (found) {
+            send_gesture(recognized);
+#if MBED_CONF_APP_IMU_GESTURE_REPORT
+            print_cycles("GESTURE", gesture_cycles, GESTURE_CYCLE_BUDGET);
+#if MBED_CONF_APP_IMU_ORIENTATION
+            FusionEuler euler = orientation.get_euler();
+            FusionVector linear = orientation.get_linear_acceleration();
+            printf("ORIENTATION roll %d pitch %d yaw %d deg, linear (%d, %d, %d) mg\n",
+                (int) euler.angle.roll, (int) euler.angle.pitch, (int) euler.angle.yaw,
+                (int) (linear.axis.x * 1000), (int) (linear.axis.y * 1000), (int) (linear.axis.z * 1000)
+            );
+            print_cycles("ORIENTATION", orientation_cycles, ORIENTATION_CYCLE_BUDGET);
+#endif
+#endif
+        }
+    }
+}
+
+/**
+ * @brief Run every sample of a FIFO batch through the orientation tracker
+ * and the recognizer, on the sensor thread.
+ */
+static void on_imu_samples(const imu_sample *samples, int count)
+{
+#if MBED_CONF_APP_IMU_ORIENTATION
+    // the recognizer gets the samples as the tracker sees them, without
+    // the gyroscope offset and gravity
+    static imu_sample tracked[TRACKED_BATCH_LENGTH];
+
+    while (count > 0) {
+        int length = count < TRACKED_BATCH_LENGTH ? count : TRACKED_BATCH_LENGTH;
+
+        // the whole batch in one update, counted per sample
+        uint32_t batch_start = DWT->CYCCNT;
+        orientation.add_samples(samples, length, tracked);
+        uint32_t batch_cycles = (DWT->CYCCNT - batch_start) / length;
+        for (int i = 0; i < length; i++) {
+            count_cycles(orientation_cycles, batch_cycles, ORIENTATION_CYCLE_BUDGET);
+        }
+
+        recognize_samples(tracked, length);
+        samples += length;
+        count -= length;
+    }
+#else
+    recognize_samples(samples, count);
+#endif
+}
+#endif
+
+void run_gesture_pipeline(mbed::Callback<void(const gesture &)> on_gesture)
+{
+    send_gesture = on_gesture;
+    sensors_init();
+#if MBED_CONF_APP_IMU_EMBEDDED_GESTURES
+    start_imu_events(callback(on_imu_events));
+#else
+    cycle_counter_init();
+    start_imu_tracking(callback(on_imu_samples));
+#endif
+}
@@ -0,0 +1,21 @@
+#ifndef GESTURE_PIPELINE_HPP
+#define GESTURE_PIPELINE_HPP
+
+#include "mbed.h"
+
+#include "gesture_recognizer.hpp"
+
+/**
+ * @brief Recognize gestures from the IMU on the calling thread.
+ *
+ * Starts the sensors, then either streams the FIFO through the orientation
+ * tracker and the recognizer or maps the embedded function events, as set
+ * by the imu-* options of mbed_app.json.
+ *
+ * This function does not return.
+ *
+ * @param on_gesture called on the calling thread with every gesture.
+ */
+void run_gesture_pipeline(mbed::Callback<void(const gesture &)> on_gesture);
+
+#endif
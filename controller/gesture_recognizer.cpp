@@ -0,0 +1,219 @@
+#include <stdlib.h>
+
+#include "gesture_recognizer.hpp"
+
+// Gyroscope counts are 70 mdps at the 2000 dps full scale, accelerometer
+// counts 0.061 mg at 2 g; both come at IMU_FIFO_ODR_HZ
+#define GYRO_COUNTS_PER_DPS         (1000 / 70)
+#define ACCEL_COUNTS_PER_G          16393
+
+// A rotation starts above 150 dps averaged over the window and ends below
+// 50 dps
+#define ROTATION_ON_COUNTS          (150 * GYRO_COUNTS_PER_DPS)
+#define ROTATION_OFF_COUNTS         (50 * GYRO_COUNTS_PER_DPS)
+
+// A shake starts above 0.8 g of standard deviation over the three axes and
+// ends below 0.3 g, in squared counts
+#define SHAKE_ON_VARIANCE           ((int64_t) (ACCEL_COUNTS_PER_G * 8 / 10) * (ACCEL_COUNTS_PER_G * 8 / 10))
+#define SHAKE_OFF_VARIANCE          ((int64_t) (ACCEL_COUNTS_PER_G * 3 / 10) * (ACCEL_COUNTS_PER_G * 3 / 10))
+
+// Summed gyroscope counts for one degree of rotation
+#define COUNTS_PER_DEGREE           (GYRO_COUNTS_PER_DPS * IMU_FIFO_ODR_HZ)
+#define DEGREES_PER_COLUMN          20
+#define DEGREES_PER_TURN            90
+#define DEGREES_PER_ROW             10
+#define HARD_DROP_DEGREES           45
+#define MAX_COLUMNS                 9
+#define MAX_TURNS                   3
+
+// Quiet time after a gesture, and longest motion taken as one gesture
+#define REFRACTORY_SAMPLES          (300 * IMU_FIFO_ODR_HZ / 1000)
+#define MAX_MOTION_SAMPLES          (1000 * IMU_FIFO_ODR_HZ / 1000)
+
+// Window channels
+#define CHANNEL_GYRO            0
+#define CHANNEL_ACCEL           3
+
+GestureRecognizer::GestureRecognizer()
+    : motion(MOTION_NONE), angle_counts(0), motion_samples(0), refractory_left(0)
+{
+}
+
+/**
+ * @brief Accelerometer variance summed over the axes, times the window
+ * length squared.
+ */
+int64_t GestureRecognizer::accel_variance() const
+{
+    int64_t variance = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        variance += window.scaled_variance(CHANNEL_ACCEL + axis);
+    }
+    return variance;
+}
+
+/**
+ * @brief The motion whose feature is above its upper threshold, the shake
+ * first since shaking also turns the board.
+ */
+GestureRecognizer::Motion GestureRecognizer::strongest_motion() const
+{
+    int64_t window_squared = (int64_t) WindowLength * WindowLength;
+    if (accel_variance() > SHAKE_ON_VARIANCE * window_squared) {
+        return MOTION_SHAKE;
+    }
+
+    int strongest = 0;
+    for (int axis = 1; axis < 3; axis++) {
+        if (abs(window.sum(CHANNEL_GYRO + axis)) > abs(window.sum(CHANNEL_GYRO + strongest))) {
+            strongest = axis;
+        }
+    }
+    if (abs(window.sum(CHANNEL_GYRO + strongest)) <= ROTATION_ON_COUNTS * WindowLength) {
+        return MOTION_NONE;
+    }
+
+    switch (strongest) {
+    case 0:
+        return MOTION_PITCH;
+    case 1:
+        return MOTION_ROLL;
+    default:
+        return MOTION_TWIST;
+    }
+}
+
+/**
+ * @brief Turn the motion that just ended into a gesture.
+ *
+ * @return false if the motion is not a gesture, such as pitching back.
+ */
+bool GestureRecognizer::end_motion(gesture &out)
+{
+    int32_t degrees = abs(angle_counts) / COUNTS_PER_DEGREE;
+    Motion ended = motion;
+
+    motion = MOTION_NONE;
+    refractory_left = REFRACTORY_SAMPLES;
+
+    switch (ended) {
+    case MOTION_ROLL: {
+        int columns = degrees / DEGREES_PER_COLUMN;
+        out.action = angle_counts > 0 ? ACTION_RIGHT : ACTION_LEFT;
+        out.magnitude = columns < 1 ? 1 : columns > MAX_COLUMNS ? MAX_COLUMNS : columns;
+        return true;
+    }
+
+    case MOTION_PITCH:
+        // only forward, towards the screen
+        if (angle_counts > 0) {
+            return false;
+        }
+        if (degrees < HARD_DROP_DEGREES) {
+            int rows = degrees / DEGREES_PER_ROW;
+            out.action = ACTION_SOFT_DROP;
+            out.magnitude = rows < 1 ? 1 : rows;
+            return true;
+        }
+        out.action = ACTION_DOWN;
+        out.magnitude = 1;
+        return true;
+
+    case MOTION_TWIST: {
+        int turns = (degrees + DEGREES_PER_TURN / 2) / DEGREES_PER_TURN;
+        out.action = ACTION_FLIP_RIGHT;
+        out.magnitude = turns < 1 ? 1 : turns > MAX_TURNS ? MAX_TURNS : turns;
+        return true;
+    }
+
+    case MOTION_SHAKE:
+        out.action = ACTION_SAVE;
+        out.magnitude = 1;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool GestureRecognizer::add_sample(const imu_sample &sample, gesture &out)
+{
+    int16_t values[6] = {
+        sample.gyro[0], sample.gyro[1], sample.gyro[2],
+        sample.accel[0], sample.accel[1], sample.accel[2]
+    };
+    window.add(values);
+    if (!window.full()) {
+        return false;
+    }
+
+    if (refractory_left > 0) {
+        refractory_left--;
+        return false;
+    }
+
+    bool started = false;
+    if (motion == MOTION_NONE) {
+        motion = strongest_motion();
+        motion_samples = 0;
+        if (motion == MOTION_NONE) {
+            return false;
+        }
+        started = true;
+    }
+
+    motion_samples++;
+    bool still_moving;
+    switch (motion) {
+    case MOTION_SHAKE: {
+        int64_t window_squared = (int64_t) WindowLength * WindowLength;
+        still_moving = accel_variance() > SHAKE_OFF_VARIANCE * window_squared;
+        break;
+    }
+
+    default: {
+        int axis = motion == MOTION_PITCH ? 0 : motion == MOTION_ROLL ? 1 : 2;
+        // the rotation started within the window, count it from there
+        angle_counts = started ? window.sum(CHANNEL_GYRO + axis) : angle_counts + sample.gyro[axis];
+        still_moving = abs(window.sum(CHANNEL_GYRO + axis)) > ROTATION_OFF_COUNTS * WindowLength;
+        break;
+    }
+    }
+
+    if (still_moving && motion_samples < MAX_MOTION_SAMPLES) {
+        return false;
+    }
+    return end_motion(out);
+}
+
+int map_imu_events(const imu_events &events, gesture *out)
+{
+    int count = 0;
+
+    if (events.tap_src & IMU_TAP_DOUBLE) {
+        out[count].action = ACTION_SAVE;
+        out[count].magnitude = 1;
+        count++;
+    }
+
+    // the axis now pointing up, or down; rolling right (positive y rate)
+    // brings x down
+    if (events.d6d_src & IMU_D6D_CHANGED) {
+        uint8_t action = 0;
+        if (events.d6d_src & IMU_D6D_X_LOW) {
+            action = ACTION_RIGHT;
+        } else if (events.d6d_src & IMU_D6D_X_HIGH) {
+            action = ACTION_LEFT;
+        } else if (events.d6d_src & IMU_D6D_Y_LOW) {
+            action = ACTION_DOWN;
+        } else if (events.d6d_src & IMU_D6D_Z_LOW) {
+            action = ACTION_FLIP_RIGHT;
+        }
+        if (action) {
+            out[count].action = action;
+            out[count].magnitude = 1;
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,103 @@
+#ifndef GESTURE_RECOGNIZER_HPP
+#define GESTURE_RECOGNIZER_HPP
+
+#include <stdint.h>
+
+#include "sensor-data.hpp"
+#include "ring_window.hpp"
+
+// Action codes understood by the console, see parse_action there
+#define ACTION_LEFT         0x01
+#define ACTION_RIGHT        0x02
+#define ACTION_DOWN         0x03
+#define ACTION_SAVE         0x04
+#define ACTION_FLIP_RIGHT   0x05
+#define ACTION_SOFT_DROP    0x06
+
+/**
+ * @brief A recognized gesture, as published to the console: the action
+ * code and how strong it was (columns for a move, rows for a soft drop,
+ * quarter turns for a flip).
+ */
+struct gesture {
+    uint8_t action;
+    uint8_t magnitude;
+};
+
+/**
+ * @brief Map the LSM6DSL embedded function events to gestures.
+ *
+ * A double tap stores the piece. Orientation changes, past 60 degrees from
+ * flat: rolling onto either side moves the piece one column, pitching
+ * forward drops it, turning the board over rotates it. Coming back to flat
+ * is not a gesture.
+ *
+ * @param out room for two gestures, one from each source.
+ * @return the number of gestures.
+ */
+int map_imu_events(const imu_events &events, gesture *out);
+
+/**
+ * @brief Turns the IMU sample stream into gestures, one sample at a time.
+ *
+ * With the board held flat, buttons towards the player:
+ * - rolling it left or right moves the piece, one column per 20 degrees;
+ * - pitching it forward drops the piece, a tilt under 45 degrees only
+ *   lowers it, one row per 10 degrees;
+ * - twisting it flat rotates the piece, one quarter turn per 90 degrees;
+ * - shaking it stores the piece.
+ *
+ * Rotations are tracked on the gyroscope rate averaged over a sliding
+ * window, shakes on the accelerometer variance over the same window. Fed
+ * the samples of the orientation tracker, the gyroscope comes without its
+ * offset and the accelerometer without gravity, so a fast roll or pitch,
+ * which swings gravity across the axes, adds nothing to the variance. A
+ * gesture starts when its feature goes above an upper threshold and ends
+ * when it falls back below a lower one, then nothing is recognized for a
+ * refractory period so the wrist coming back is not taken for the opposite
+ * gesture.
+ *
+ * Every sample costs the same few integer operations whatever the window
+ * length; nothing is allocated.
+ */
+class GestureRecognizer {
+public:
+    GestureRecognizer();
+
+    /**
+     * @brief Feed the next sample, at the FIFO rate, raw or as given back
+     * by OrientationTracker::add_samples().
+     *
+     * @param out the gesture, when one ends on this sample.
+     * @return true if a gesture was recognized.
+     */
+    bool add_sample(const imu_sample &sample, gesture &out);
+
+private:
+    static const int WindowLength = 32;
+
+    enum Motion {
+        MOTION_NONE,
+        MOTION_ROLL,
+        MOTION_PITCH,
+        MOTION_TWIST,
+        MOTION_SHAKE
+    };
+
+    Motion strongest_motion() const;
+
+    int64_t accel_variance() const;
+
+    bool end_motion(gesture &out);
+
+    // gyroscope x, y, z then accelerometer x, y, z, as in imu_sample
+    RingWindow<int16_t, WindowLength, 6> window;
+
+    Motion motion;
+    // gyroscope counts summed over the motion, the angle it turned
+    int32_t angle_counts;
+    int motion_samples;
+    int refractory_left;
+};
+
+#endif
@@ -0,0 +1,232 @@
+/**
+ * @file ahrs_bench.cpp
+ *
+ * @brief Cost of the orientation tracking stage per sample: the Fusion
+ * gyroscope offset correction, the AHRS update without magnetometer and the
+ * linear acceleration, with the settings of OrientationTracker.
+ *
+ * The first INITIALISATION_PERIOD seconds of samples cost more, the AHRS
+ * also zeroes the heading on every update then, so they are timed apart
+ * from the steady state. The stream is a board waved about at 416 Hz.
+ *
+ * The steady state then runs again through FusionAhrsUpdateBatch in FIFO
+ * sized blocks, against one FusionAhrsUpdateNoMagnetometer call per
+ * sample, with the largest angle between the two orientations over the
+ * stream.
+ *
+ * Usage: blockbash-ahrs-bench [options]
+ *   -n SAMPLES  steady state samples (default 2000000)
+ *   -b LENGTH   batch length, can be given several times (default 16, 32)
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Fusion/Fusion.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static const int SampleRate = 416;
+static const float DeltaTime = 1.0f / SampleRate;
+// AHRS initialisation, in samples
+static const int InitialisationSamples = 3 * SampleRate;
+
+struct Sample {
+    FusionVector gyroscope;
+    FusionVector accelerometer;
+};
+
+static std::vector<Sample> make_stream(int samples)
+{
+    std::vector<Sample> stream(samples);
+    for (int i = 0; i < samples; i++) {
+        float t = (float) i / SampleRate;
+        float roll = 0.8f * std::sin(2.0f * t);
+        float pitch = 0.5f * std::sin(1.3f * t);
+        stream[i].gyroscope = (FusionVector) {.array = {
+            FusionRadiansToDegrees(1.6f * std::cos(2.0f * t)),
+            FusionRadiansToDegrees(0.65f * std::cos(1.3f * t)),
+            30.0f * std::sin(0.7f * t),
+        }};
+        stream[i].accelerometer = (FusionVector) {.array = {
+            -std::sin(pitch),
+            std::sin(roll) * std::cos(pitch),
+            std::cos(roll) * std::cos(pitch) + 0.1f * std::sin(40.0f * t),
+        }};
+    }
+    return stream;
+}
+
+static void initialise(FusionOffset &offset, FusionAhrs &ahrs)
+{
+    FusionOffsetInitialise(&offset, SampleRate);
+    FusionAhrsInitialise(&ahrs);
+    const FusionAhrsSettings settings = {
+        .convention = FusionConventionNwu,
+        .gain = 0.5f,
+        .gyroscopeRange = 2000.0f,
+        .accelerationRejection = 10.0f,
+        .magneticRejection = 0.0f,
+        .recoveryTriggerPeriod = 5 * SampleRate,
+    };
+    FusionAhrsSetSettings(&ahrs, &settings);
+}
+
+/**
+ * @return ns per sample over stream[first, last).
+ */
+static double run(FusionOffset &offset, FusionAhrs &ahrs, const std::vector<Sample> &stream,
+                  int first, int last, FusionVector &checksum)
+{
+    SteadyClock::time_point start = SteadyClock::now();
+    for (int i = first; i < last; i++) {
+        FusionVector gyroscope = FusionOffsetUpdate(&offset, stream[i].gyroscope);
+        FusionAhrsUpdateNoMagnetometer(&ahrs, gyroscope, stream[i].accelerometer, DeltaTime);
+        checksum = FusionVectorAdd(checksum, FusionAhrsGetLinearAcceleration(&ahrs));
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    return elapsed.count() / (last - first);
+}
+
+/**
+ * Orientation update only, one call per sample, keeping the quaternion
+ * after every sample for comparison.
+ */
+static double run_per_sample(FusionAhrs &ahrs, const std::vector<Sample> &stream, int first, int last,
+                             std::vector<FusionQuaternion> &quaternions)
+{
+    SteadyClock::time_point start = SteadyClock::now();
+    for (int i = first; i < last; i++) {
+        FusionAhrsUpdateNoMagnetometer(&ahrs, stream[i].gyroscope, stream[i].accelerometer, DeltaTime);
+        quaternions[i - first] = FusionAhrsGetQuaternion(&ahrs);
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    return elapsed.count() / (last - first);
+}
+
+/**
+ * Orientation update only, batch_length samples per call, keeping the
+ * quaternion after every sample for comparison.
+ */
+static double run_batch(FusionAhrs &ahrs, const std::vector<FusionVector> &gyroscope,
+                        const std::vector<FusionVector> &accelerometer, int first, int last,
+                        int batch_length, std::vector<FusionQuaternion> &quaternions)
+{
+    SteadyClock::time_point start = SteadyClock::now();
+    for (int i = first; i < last; i += batch_length) {
+        int length = last - i < batch_length ? last - i : batch_length;
+        FusionAhrsUpdateBatch(&ahrs, &gyroscope[i], &accelerometer[i], length, DeltaTime,
+                              &quaternions[i - first], 1);
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    return elapsed.count() / (last - first);
+}
+
+/**
+ * Largest angle between two orientations over the stream, in degrees.
+ */
+static double max_angle(const std::vector<FusionQuaternion> &a, const std::vector<FusionQuaternion> &b)
+{
+    double largest = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        // from the chord between the two, precise for small angles
+        double dot = 0;
+        for (int element = 0; element < 4; element++) {
+            dot += (double) a[i].array[element] * b[i].array[element];
+        }
+        double sign = dot < 0 ? -1 : 1;
+        double chord = 0;
+        for (int element = 0; element < 4; element++) {
+            double difference = a[i].array[element] - sign * b[i].array[element];
+            chord += difference * difference;
+        }
+        double angle = 4 * std::asin(std::sqrt(chord) / 2) * 180 / M_PI;
+        if (angle > largest) {
+            largest = angle;
+        }
+    }
+    return largest;
+}
+
+int main(int argc, char **argv)
+{
+    int samples = 2000000;
+    std::vector<int> batch_lengths;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:b:h")) != -1) {
+        switch (option) {
+        case 'n': samples = std::atoi(optarg); break;
+        case 'b': batch_lengths.push_back(std::atoi(optarg)); break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples] [-b batch length]...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (samples <= 0) {
+        fprintf(stderr, "samples must be positive\n");
+        return 1;
+    }
+    if (batch_lengths.empty()) {
+        batch_lengths = { 16, 32 };
+    }
+    for (int batch_length : batch_lengths) {
+        if (batch_length <= 0) {
+            fprintf(stderr, "batch length must be positive\n");
+            return 1;
+        }
+    }
+
+    std::vector<Sample> stream = make_stream(InitialisationSamples + samples);
+    FusionOffset offset;
+    FusionAhrs ahrs;
+    FusionVector checksum = FUSION_VECTOR_ZERO;
+
+    initialise(offset, ahrs);
+    double initialising_ns = run(offset, ahrs, stream, 0, InitialisationSamples, checksum);
+    double steady_ns = run(offset, ahrs, stream, InitialisationSamples, (int) stream.size(), checksum);
+
+    FusionEuler euler = FusionQuaternionToEuler(FusionAhrsGetQuaternion(&ahrs));
+    printf("%d Hz, %d steady state samples\n", SampleRate, samples);
+    printf("initialising  %8.1f ns/sample\n", initialising_ns);
+    printf("steady state  %8.1f ns/sample, %.0f samples/s on one core\n", steady_ns, 1e9 / steady_ns);
+    printf("final roll %.1f pitch %.1f yaw %.1f deg (checksum %g)\n",
+           euler.angle.roll, euler.angle.pitch, euler.angle.yaw, FusionVectorSum(checksum));
+
+    // the same steady state, from the same initialised state, per sample
+    // and in batches
+    std::vector<FusionVector> gyroscope(stream.size());
+    std::vector<FusionVector> accelerometer(stream.size());
+    for (size_t i = 0; i < stream.size(); i++) {
+        gyroscope[i] = stream[i].gyroscope;
+        accelerometer[i] = stream[i].accelerometer;
+    }
+    FusionAhrs initialised;
+    initialise(offset, initialised);
+    for (int i = 0; i < InitialisationSamples; i++) {
+        FusionAhrsUpdateNoMagnetometer(&initialised, stream[i].gyroscope, stream[i].accelerometer, DeltaTime);
+    }
+
+    std::vector<FusionQuaternion> per_sample(samples);
+    std::vector<FusionQuaternion> batched(samples);
+    ahrs = initialised;
+    double per_sample_ns = run_per_sample(ahrs, stream, InitialisationSamples, (int) stream.size(), per_sample);
+
+    printf("\n%-12s %12s %10s %14s\n", "update", "ns/sample", "speedup", "max diff deg");
+    printf("%-12s %12.1f %10s %14s\n", "per sample", per_sample_ns, "1.00", "-");
+    for (int batch_length : batch_lengths) {
+        ahrs = initialised;
+        double batch_ns = run_batch(ahrs, gyroscope, accelerometer, InitialisationSamples,
+                                    (int) stream.size(), batch_length, batched);
+        char name[32];
+        snprintf(name, sizeof(name), "batch %d", batch_length);
+        printf("%-12s %12.1f %10.2f %14.2e\n", name, batch_ns, per_sample_ns / batch_ns,
+               max_angle(per_sample, batched));
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file euler_bench.cpp
+ *
+ * @brief Accuracy and cost of FusionQuaternionToEuler with the polynomial
+ * arc tangents of FUSION_FAST_EULER_MAX_ERROR, against atan2f and asinf.
+ *
+ * The sweep converts orientations on a grid of roll, pitch and yaw, plus
+ * random ones, and compares every build with the same conversion done in
+ * double from the same float quaternion, so the error is the one of the
+ * arc tangents and float evaluation, not of the quaternions. Within
+ * GIMBAL_LOCK_SINE of a pitch of +/-90 degrees roll and yaw are not defined
+ * and are left out, and the pitch is reported apart: there the arc sine
+ * magnifies the rounding of its float argument, for asinf as much.
+ *
+ * The arc tangent alone, in degrees, is swept around the unit circle
+ * against atan2 in double from the same float arguments; that error is the
+ * one FUSION_FAST_EULER_MAX_ERROR bounds.
+ *
+ * The cost is the time per conversion over the same quaternions, the
+ * host counterpart of a cycle count: the board would see the libm calls
+ * replaced by a division, a square root and a few multiply-adds. On an x86
+ * host a conversion came out 1.5-2.2 times faster than libm over repeated
+ * Release runs, only 1.05-1.3 times in the default unoptimised build, so
+ * configure with -DCMAKE_BUILD_TYPE=Release before comparing.
+ *
+ * Usage: blockbash-euler-bench [options]
+ *   -s STEP     grid step in degrees (default 2)
+ *   -n SAMPLES  random orientations added to the grid (default 1000000)
+ *   -a SAMPLES  points of the arc tangent sweep (default 10000000)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "euler_bench.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+
+// sine of the pitch beyond which roll and yaw are not compared, 0.8 degrees
+// from +/-90
+static const double GIMBAL_LOCK_SINE = 0.9999;
+
+// keeps the timed conversions from being optimised away
+static volatile float sink;
+
+static FusionQuaternion from_euler(double roll, double pitch, double yaw)
+{
+    double cr = std::cos(roll / 2), sr = std::sin(roll / 2);
+    double cp = std::cos(pitch / 2), sp = std::sin(pitch / 2);
+    double cy = std::cos(yaw / 2), sy = std::sin(yaw / 2);
+    return (FusionQuaternion) {.array = {
+        (float) (cr * cp * cy + sr * sp * sy),
+        (float) (sr * cp * cy - cr * sp * sy),
+        (float) (cr * sp * cy + sr * cp * sy),
+        (float) (cr * cp * sy - sr * sp * cy),
+    }};
+}
+
+/**
+ * FusionQuaternionToEuler in double, the reference.
+ */
+static void to_euler(const FusionQuaternion &quaternion, double angles[3])
+{
+    double w = quaternion.element.w, x = quaternion.element.x;
+    double y = quaternion.element.y, z = quaternion.element.z;
+    double half_minus_y_squared = 0.5 - y * y;
+    double sine = std::max(-1.0, std::min(1.0, 2 * (w * y - z * x)));
+    angles[0] = std::atan2(w * x + y * z, half_minus_y_squared - x * x) * 180 / M_PI;
+    angles[1] = std::asin(sine) * 180 / M_PI;
+    angles[2] = std::atan2(w * z + x * y, half_minus_y_squared - z * z) * 180 / M_PI;
+}
+
+/**
+ * Difference between two angles in degrees, across the +/-180 wrap.
+ */
+static double difference(double a, double b)
+{
+    double d = std::fmod(std::fabs(a - b), 360.0);
+    return d > 180 ? 360 - d : d;
+}
+
+int main(int argc, char **argv)
+{
+    double step = 2;
+    int samples = 1000000;
+    int arc_samples = 10000000;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:n:a:h")) != -1) {
+        switch (option) {
+        case 's': step = std::atof(optarg); break;
+        case 'n': samples = std::atoi(optarg); break;
+        case 'a': arc_samples = std::atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-s step] [-n samples] [-a arc samples]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (step <= 0 || samples < 0 || arc_samples <= 0) {
+        fprintf(stderr, "step and arc samples must be positive and samples not negative\n");
+        return 1;
+    }
+
+    std::vector<FusionQuaternion> quaternions;
+    for (double roll = -180; roll <= 180; roll += step) {
+        for (double pitch = -90; pitch <= 90; pitch += step) {
+            for (double yaw = -180; yaw <= 180; yaw += step) {
+                quaternions.push_back(from_euler(roll * M_PI / 180, pitch * M_PI / 180, yaw * M_PI / 180));
+            }
+        }
+    }
+    std::mt19937 generator(1);
+    std::normal_distribution<double> normal;
+    for (int i = 0; i < samples; i++) {
+        double q[4];
+        double norm = 0;
+        for (double &element : q) {
+            element = normal(generator);
+            norm += element * element;
+        }
+        norm = std::sqrt(norm);
+        quaternions.push_back((FusionQuaternion) {.array = {
+            (float) (q[0] / norm), (float) (q[1] / norm), (float) (q[2] / norm), (float) (q[3] / norm),
+        }});
+    }
+
+    std::vector<double> reference(3 * quaternions.size());
+    for (size_t i = 0; i < quaternions.size(); i++) {
+        to_euler(quaternions[i], &reference[3 * i]);
+    }
+
+    std::vector<euler_build> builds = euler_builds();
+    std::sort(builds.begin(), builds.end(), [](const euler_build &a, const euler_build &b) {
+        return a.max_error == 0 || (b.max_error != 0 && a.max_error > b.max_error);
+    });
+
+    printf("%zu orientations, %d arc tangents, max errors in degrees\n", quaternions.size(), arc_samples);
+    printf("%-14s %10s %10s %10s %10s %10s %10s %10s\n", "build", "atan2", "roll", "pitch", "yaw",
+           "pitch +-90", "ns/call", "speedup");
+    double libm_ns = 0;
+    for (const euler_build &build : builds) {
+        double atan2_error = 0;
+        for (int i = 0; i < arc_samples; i++) {
+            double angle = 2 * M_PI * i / arc_samples - M_PI;
+            float y = (float) std::sin(angle);
+            float x = (float) std::cos(angle);
+            atan2_error = std::max(atan2_error, difference(build.atan2_degrees(y, x), std::atan2((double) y, (double) x) * 180 / M_PI));
+        }
+
+        // roll, pitch, yaw and pitch near +/-90
+        double max_errors[4] = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < quaternions.size(); i++) {
+            FusionEuler euler = build.convert(quaternions[i]);
+            const double *expected = &reference[3 * i];
+            if (std::fabs(std::sin(expected[1] * M_PI / 180)) > GIMBAL_LOCK_SINE) {
+                max_errors[3] = std::max(max_errors[3], difference(euler.angle.pitch, expected[1]));
+                continue;
+            }
+            for (int angle = 0; angle < 3; angle++) {
+                max_errors[angle] = std::max(max_errors[angle], difference(euler.array[angle], expected[angle]));
+            }
+        }
+
+        // best of three passes
+        double ns = 0;
+        float checksum = 0;
+        for (int pass = 0; pass < 3; pass++) {
+            SteadyClock::time_point start = SteadyClock::now();
+            for (const FusionQuaternion &quaternion : quaternions) {
+                FusionEuler euler = build.convert(quaternion);
+                checksum += euler.angle.roll + euler.angle.pitch + euler.angle.yaw;
+            }
+            std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+            double pass_ns = elapsed.count() / quaternions.size();
+            ns = pass == 0 ? pass_ns : std::min(ns, pass_ns);
+        }
+        sink = checksum;
+        if (build.max_error == 0) {
+            libm_ns = ns;
+        }
+
+        char name[32];
+        if (build.max_error == 0) {
+            snprintf(name, sizeof(name), "libm");
+        } else {
+            snprintf(name, sizeof(name), "fast %d", build.max_error);
+        }
+        printf("%-14s %10.2e %10.2e %10.2e %10.2e %10.2e %10.1f %10.2f\n", name, atan2_error,
+               max_errors[0], max_errors[1], max_errors[2], max_errors[3], ns, libm_ns / ns);
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef EULER_BENCH_HPP
+#define EULER_BENCH_HPP
+
+#include <vector>
+
+#include "Fusion/Fusion.h"
+
+/**
+ * @brief One build of FusionQuaternionToEuler for blockbash-euler-bench, by
+ * its FUSION_FAST_EULER_MAX_ERROR in microdegrees, 0 for atan2f and asinf.
+ */
+struct euler_build {
+    int max_error;
+    FusionEuler (*convert)(FusionQuaternion quaternion);
+    float (*atan2_degrees)(float y, float x);
+};
+
+/**
+ * @brief The builds linked in, euler_tier.cpp adds one per compilation.
+ */
+inline std::vector<euler_build> &euler_builds()
+{
+    static std::vector<euler_build> builds;
+    return builds;
+}
+
+struct euler_registration {
+    euler_registration(int max_error, FusionEuler (*convert)(FusionQuaternion quaternion),
+                       float (*atan2_degrees)(float y, float x))
+    {
+        euler_builds().push_back({ max_error, convert, atan2_degrees });
+    }
+};
+
+#endif
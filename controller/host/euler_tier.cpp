@@ -0,0 +1,31 @@
+/**
+ * @file euler_tier.cpp
+ *
+ * @brief FusionQuaternionToEuler as FUSION_FAST_EULER_MAX_ERROR selects it,
+ * atan2f and asinf when it is not defined. Compiled once per error for
+ * blockbash-euler-bench, each compilation registering its build.
+ */
+
+#include "euler_bench.hpp"
+
+#ifndef FUSION_FAST_EULER_MAX_ERROR
+#define EULER_MAX_ERROR 0
+#else
+#define EULER_MAX_ERROR FUSION_FAST_EULER_MAX_ERROR
+#endif
+
+static FusionEuler convert(FusionQuaternion quaternion)
+{
+    return FusionQuaternionToEuler(quaternion);
+}
+
+static float atan2_degrees(float y, float x)
+{
+#ifdef FUSION_FAST_EULER_MAX_ERROR
+    return FusionFastAtan2Degrees(y, x);
+#else
+    return FusionRadiansToDegrees(atan2f(y, x));
+#endif
+}
+
+static euler_registration registration(EULER_MAX_ERROR, convert, atan2_degrees);
@@ -0,0 +1,281 @@
+/**
+ * @file fixed_bench.cpp
+ *
+ * @brief The fixed-point AHRS, FusionAhrsFixed, against the float one,
+ * FusionAhrs, on the same IMU traces: the largest and mean angle between
+ * their orientations, the largest difference between their linear
+ * accelerations and the cost of each per sample.
+ *
+ * Both run with the settings of OrientationTracker, from start-up, so the
+ * initialisation (gain ramp and heading zeroing) is covered as well. The
+ * traces are a board lying still, waved about, shaken and spun about near
+ * the gyroscope range, or a recording in the CSV format of the Fusion
+ * examples: time, gyroscope X Y Z in degrees per second and accelerometer
+ * X Y Z in g, after a header line.
+ *
+ * The fixed-point outputs are also hashed, the hash of a trace is the same
+ * wherever the fixed-point AHRS runs.
+ *
+ * Usage: blockbash-fixed-bench [options]
+ *   -n SAMPLES  samples per synthetic trace (default 200000)
+ *   -f FILE     recorded trace instead of the synthetic ones
+ *   -r RATE     sample rate of the recorded trace in Hz (default 416)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Fusion/Fusion.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static const int DefaultSampleRate = 416;
+
+struct Trace {
+    std::string name;
+    int sample_rate;
+    std::vector<FusionVector> gyroscope;
+    std::vector<FusionVector> accelerometer;
+};
+
+/**
+ * Synthetic trace from the orientation of the board as roll and pitch over
+ * time, with its rates, plus extra acceleration and noise.
+ */
+static Trace make_trace(const char *name, int samples, float roll_amplitude, float roll_frequency,
+                        float pitch_amplitude, float pitch_frequency, float yaw_rate,
+                        float shake, float noise)
+{
+    Trace trace = { name, DefaultSampleRate, std::vector<FusionVector>(samples), std::vector<FusionVector>(samples) };
+    srand(1);
+    for (int i = 0; i < samples; i++) {
+        float t = (float) i / DefaultSampleRate;
+        float roll = roll_amplitude * std::sin(roll_frequency * t);
+        float pitch = pitch_amplitude * std::sin(pitch_frequency * t);
+        float jitter[6];
+        for (float &value : jitter) {
+            value = noise * ((float) rand() / RAND_MAX - 0.5f);
+        }
+        trace.gyroscope[i] = (FusionVector) {.array = {
+            FusionRadiansToDegrees(roll_amplitude * roll_frequency * std::cos(roll_frequency * t)) + 100 * jitter[0],
+            FusionRadiansToDegrees(pitch_amplitude * pitch_frequency * std::cos(pitch_frequency * t)) + 100 * jitter[1],
+            yaw_rate + 100 * jitter[2],
+        }};
+        trace.accelerometer[i] = (FusionVector) {.array = {
+            -std::sin(pitch) + shake * std::sin(37.0f * t) + jitter[3],
+            std::sin(roll) * std::cos(pitch) + shake * std::sin(29.0f * t) + jitter[4],
+            std::cos(roll) * std::cos(pitch) + shake * std::sin(41.0f * t) + jitter[5],
+        }};
+    }
+    return trace;
+}
+
+static bool read_trace(const char *path, int sample_rate, Trace &trace)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    trace = { path, sample_rate, {}, {} };
+    char line[256];
+    if (fgets(line, sizeof(line), file) == NULL) { // header
+        fclose(file);
+        return false;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        float time;
+        FusionVector gyroscope;
+        FusionVector accelerometer;
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f,%f", &time,
+                   &gyroscope.axis.x, &gyroscope.axis.y, &gyroscope.axis.z,
+                   &accelerometer.axis.x, &accelerometer.axis.y, &accelerometer.axis.z) == 7) {
+            trace.gyroscope.push_back(gyroscope);
+            trace.accelerometer.push_back(accelerometer);
+        }
+    }
+    fclose(file);
+    return !trace.gyroscope.empty();
+}
+
+static FusionAhrsSettings settings_for(int sample_rate)
+{
+    const FusionAhrsSettings settings = {
+        .convention = FusionConventionNwu,
+        .gain = 0.5f,
+        .gyroscopeRange = 2000.0f,
+        .accelerationRejection = 10.0f,
+        .magneticRejection = 0.0f,
+        .recoveryTriggerPeriod = (unsigned int) (5 * sample_rate),
+    };
+    return settings;
+}
+
+struct Outputs {
+    std::vector<FusionQuaternion> quaternions;
+    std::vector<FusionVector> linear_accelerations;
+};
+
+/**
+ * @return ns per sample.
+ */
+static double run_float(const Trace &trace, Outputs &outputs)
+{
+    const FusionAhrsSettings settings = settings_for(trace.sample_rate);
+    const float delta_time = 1.0f / trace.sample_rate;
+    FusionAhrs ahrs;
+    FusionAhrsInitialise(&ahrs);
+    FusionAhrsSetSettings(&ahrs, &settings);
+
+    SteadyClock::time_point start = SteadyClock::now();
+    for (size_t i = 0; i < trace.gyroscope.size(); i++) {
+        FusionAhrsUpdateNoMagnetometer(&ahrs, trace.gyroscope[i], trace.accelerometer[i], delta_time);
+        outputs.quaternions[i] = FusionAhrsGetQuaternion(&ahrs);
+        outputs.linear_accelerations[i] = FusionAhrsGetLinearAcceleration(&ahrs);
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    return elapsed.count() / trace.gyroscope.size();
+}
+
+/**
+ * @return ns per sample, the conversion of the inputs to Q16 left out as
+ * the board would scale its raw counts instead.
+ */
+static double run_fixed(const Trace &trace, Outputs &outputs, uint64_t &hash)
+{
+    const FusionAhrsSettings settings = settings_for(trace.sample_rate);
+    FusionAhrsFixed ahrs;
+    FusionAhrsFixedInitialise(&ahrs, 1.0f / trace.sample_rate);
+    FusionAhrsFixedSetSettings(&ahrs, &settings, 1.0f / trace.sample_rate);
+
+    size_t samples = trace.gyroscope.size();
+    std::vector<FusionFixedVector> gyroscope(samples);
+    std::vector<FusionFixedVector> accelerometer(samples);
+    for (size_t i = 0; i < samples; i++) {
+        gyroscope[i] = FusionFixedVectorFromFloat(trace.gyroscope[i], 16);
+        accelerometer[i] = FusionFixedVectorFromFloat(trace.accelerometer[i], 16);
+    }
+    std::vector<FusionFixedQuaternion> quaternions(samples);
+    std::vector<FusionFixedVector> linear_accelerations(samples);
+
+    SteadyClock::time_point start = SteadyClock::now();
+    for (size_t i = 0; i < samples; i++) {
+        FusionAhrsFixedUpdateNoMagnetometer(&ahrs, gyroscope[i], accelerometer[i]);
+        quaternions[i] = FusionAhrsFixedGetQuaternion(&ahrs);
+        linear_accelerations[i] = FusionAhrsFixedGetLinearAcceleration(&ahrs);
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+
+    // FNV-1a over the outputs, as little endian bytes
+    hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < samples; i++) {
+        int32_t values[7] = {
+            quaternions[i].array[0], quaternions[i].array[1], quaternions[i].array[2], quaternions[i].array[3],
+            linear_accelerations[i].array[0], linear_accelerations[i].array[1], linear_accelerations[i].array[2],
+        };
+        for (int32_t value : values) {
+            for (int byte = 0; byte < 4; byte++) {
+                hash = (hash ^ (((uint32_t) value >> (8 * byte)) & 0xff)) * UINT64_C(1099511628211);
+            }
+        }
+        outputs.quaternions[i] = FusionFixedQuaternionToFloat(quaternions[i]);
+        outputs.linear_accelerations[i] = FusionFixedVectorToFloat(linear_accelerations[i], 16);
+    }
+    return elapsed.count() / samples;
+}
+
+/**
+ * Angle between two orientations in degrees, from the chord between the
+ * two, precise for small angles.
+ */
+static double angle(const FusionQuaternion &a, const FusionQuaternion &b)
+{
+    double dot = 0;
+    for (int element = 0; element < 4; element++) {
+        dot += (double) a.array[element] * b.array[element];
+    }
+    double sign = dot < 0 ? -1 : 1;
+    double chord = 0;
+    for (int element = 0; element < 4; element++) {
+        double difference = a.array[element] - sign * b.array[element];
+        chord += difference * difference;
+    }
+    return 4 * std::asin(std::min(std::sqrt(chord) / 2, 1.0)) * 180 / M_PI;
+}
+
+static void compare(const Trace &trace)
+{
+    size_t samples = trace.gyroscope.size();
+    Outputs reference = { std::vector<FusionQuaternion>(samples), std::vector<FusionVector>(samples) };
+    Outputs fixed = { std::vector<FusionQuaternion>(samples), std::vector<FusionVector>(samples) };
+    uint64_t hash;
+    double float_ns = run_float(trace, reference);
+    double fixed_ns = run_fixed(trace, fixed, hash);
+
+    double max_angle = 0;
+    double total_angle = 0;
+    double max_linear = 0;
+    for (size_t i = 0; i < samples; i++) {
+        double difference = angle(reference.quaternions[i], fixed.quaternions[i]);
+        max_angle = std::max(max_angle, difference);
+        total_angle += difference;
+        for (int axis = 0; axis < 3; axis++) {
+            max_linear = std::max(max_linear, (double) std::fabs(reference.linear_accelerations[i].array[axis]
+                                                                 - fixed.linear_accelerations[i].array[axis]));
+        }
+    }
+    printf("%-10s %9zu %12.2e %12.2e %10.3f %10.1f %10.1f  %016llx\n", trace.name.c_str(), samples,
+           max_angle, total_angle / samples, max_linear * 1000, float_ns, fixed_ns, (unsigned long long) hash);
+}
+
+int main(int argc, char **argv)
+{
+    int samples = 200000;
+    const char *path = NULL;
+    int sample_rate = DefaultSampleRate;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:f:r:h")) != -1) {
+        switch (option) {
+        case 'n': samples = std::atoi(optarg); break;
+        case 'f': path = optarg; break;
+        case 'r': sample_rate = std::atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples] [-f trace.csv] [-r rate]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (samples <= 0 || sample_rate <= 0) {
+        fprintf(stderr, "samples and rate must be positive\n");
+        return 1;
+    }
+
+    std::vector<Trace> traces;
+    if (path != NULL) {
+        Trace trace;
+        if (!read_trace(path, sample_rate, trace)) {
+            fprintf(stderr, "could not read a trace from %s\n", path);
+            return 1;
+        }
+        traces.push_back(trace);
+    } else {
+        //                          roll        pitch       yaw   shake noise
+        traces.push_back(make_trace("still", samples, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.01f));
+        traces.push_back(make_trace("wave", samples, 0.8f, 2.0f, 0.5f, 1.3f, 30.0f, 0.1f, 0.01f));
+        traces.push_back(make_trace("shake", samples, 0.3f, 9.0f, 0.2f, 7.0f, 0.0f, 1.5f, 0.05f));
+        traces.push_back(make_trace("spin", samples, 0.2f, 1.0f, 0.1f, 0.7f, 1900.0f, 0.2f, 0.02f));
+    }
+
+    printf("%-10s %9s %12s %12s %10s %10s %10s  %s\n", "trace", "samples", "max deg", "mean deg",
+           "max mg", "float ns", "fixed ns", "fixed output hash");
+    for (const Trace &trace : traces) {
+        compare(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file inverse_sqrt_bench.cpp
+ *
+ * @brief Accuracy and cost of each FUSION_INVERSE_SQRT policy: the bit
+ * hack, the hardware square root and two Newton steps.
+ *
+ * Accuracy is the largest error of FusionInverseSqrt relative to the
+ * inverse square root in double, over operands from 1e-6 to 1e6 and over
+ * operands within 1% of one, those of the normalisations in the AHRS. The
+ * AHRS sees it through the quaternion: a gyroscope integration at 416 Hz,
+ * 60 s of tumbling at 200 degrees per second, is normalised with each
+ * policy and compared with the same integration in double, for the angle
+ * it ends up away and how far its magnitude strays from one.
+ *
+ * Cost is the time per FusionInverseSqrt, FusionVectorNormalise and
+ * FusionQuaternionNormalise call, through a function pointer. On x86-64 the
+ * quaternion argument also goes through the stack and stalls the load of
+ * it, the same for every policy. The Cortex-M4F costs differ from the host
+ * ones: VSQRT and VDIV take 14 cycles each there, the Newton steps are a
+ * handful of single cycle multiplies.
+ *
+ * Usage: blockbash-inverse-sqrt-bench [options]
+ *   -n SAMPLES  operands per sweep and calls per timing (default 10000000)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "inverse_sqrt_bench.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static const int SampleRate = 416;
+
+// keeps the timed calls from being optimised away
+static volatile float sink;
+
+static double relative_error(const inverse_sqrt_build &build, const std::vector<float> &operands)
+{
+    double largest = 0;
+    for (float x : operands) {
+        double expected = 1 / std::sqrt((double) x);
+        largest = std::max(largest, std::fabs(build.inverse_sqrt(x) - expected) / expected);
+    }
+    return largest;
+}
+
+/**
+ * Integrates a tumbling rotation as FusionAhrsUpdate does, normalising with
+ * the build, and in double.
+ *
+ * @param angle angle between the two at the end, in degrees
+ * @param magnitude_error largest distance of the float magnitude from one
+ */
+static void integrate(const inverse_sqrt_build &build, double &angle, double &magnitude_error)
+{
+    const float delta_time = 1.0f / SampleRate;
+    FusionQuaternion quaternion = FUSION_IDENTITY_QUATERNION;
+    double reference[4] = { 1, 0, 0, 0 };
+    magnitude_error = 0;
+    for (int i = 0; i < 60 * SampleRate; i++) {
+        float t = (float) i / SampleRate;
+        const FusionVector gyroscope = {.axis = {
+            200.0f * std::cos(0.3f * t), 200.0f * std::sin(0.5f * t), 120.0f,
+        }};
+        const FusionVector halfRotation = FusionVectorMultiplyScalar(gyroscope, FusionDegreesToRadians(0.5f) * delta_time);
+        quaternion = build.quaternion_normalise(FusionQuaternionAdd(quaternion, FusionQuaternionMultiplyVector(quaternion, halfRotation)));
+
+        double v[3] = { halfRotation.axis.x, halfRotation.axis.y, halfRotation.axis.z };
+        double q[4] = {
+            reference[0] - reference[1] * v[0] - reference[2] * v[1] - reference[3] * v[2],
+            reference[1] + reference[0] * v[0] + reference[2] * v[2] - reference[3] * v[1],
+            reference[2] + reference[0] * v[1] - reference[1] * v[2] + reference[3] * v[0],
+            reference[3] + reference[0] * v[2] + reference[1] * v[1] - reference[2] * v[0],
+        };
+        double norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int element = 0; element < 4; element++) {
+            reference[element] = q[element] / norm;
+        }
+
+        double magnitude = 0;
+        for (int element = 0; element < 4; element++) {
+            magnitude += (double) quaternion.array[element] * quaternion.array[element];
+        }
+        magnitude_error = std::max(magnitude_error, std::fabs(std::sqrt(magnitude) - 1));
+    }
+
+    // from the chord between the two, precise for small angles
+    double dot = 0;
+    for (int element = 0; element < 4; element++) {
+        dot += quaternion.array[element] * reference[element];
+    }
+    double sign = dot < 0 ? -1 : 1;
+    double chord = 0;
+    for (int element = 0; element < 4; element++) {
+        double difference = quaternion.array[element] - sign * reference[element];
+        chord += difference * difference;
+    }
+    angle = 4 * std::asin(std::min(std::sqrt(chord) / 2, 1.0)) * 180 / M_PI;
+}
+
+/**
+ * @return ns per call, best of three passes.
+ */
+template<typename Call>
+static double time_calls(int calls, Call call)
+{
+    double best = 0;
+    for (int pass = 0; pass < 3; pass++) {
+        SteadyClock::time_point start = SteadyClock::now();
+        float checksum = 0;
+        for (int i = 0; i < calls; i++) {
+            checksum += call(i);
+        }
+        sink = checksum;
+        std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+        double ns = elapsed.count() / calls;
+        best = pass == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int samples = 10000000;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:h")) != -1) {
+        switch (option) {
+        case 'n': samples = std::atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (samples <= 0) {
+        fprintf(stderr, "samples must be positive\n");
+        return 1;
+    }
+
+    std::vector<float> wide(samples);
+    std::vector<float> near_one(samples);
+    for (int i = 0; i < samples; i++) {
+        wide[i] = (float) std::pow(10.0, -6 + 12.0 * i / samples);
+        near_one[i] = 0.99f + 0.02f * i / samples;
+    }
+
+    // what the AHRS normalises: accelerometer readings and quaternions
+    // just off unit magnitude
+    const int inputs = 4096;
+    std::mt19937 generator(1);
+    std::normal_distribution<float> normal;
+    std::vector<FusionVector> vectors(inputs);
+    std::vector<FusionQuaternion> quaternions(inputs);
+    for (int i = 0; i < inputs; i++) {
+        vectors[i] = (FusionVector) {.array = { normal(generator), normal(generator), normal(generator) }};
+        float q[4] = { normal(generator), normal(generator), normal(generator), normal(generator) };
+        float norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) * (1 + 1e-4f * normal(generator));
+        quaternions[i] = (FusionQuaternion) {.array = { q[0] / norm, q[1] / norm, q[2] / norm, q[3] / norm }};
+    }
+
+    std::vector<inverse_sqrt_build> builds = inverse_sqrt_builds();
+    std::sort(builds.begin(), builds.end(), [](const inverse_sqrt_build &a, const inverse_sqrt_build &b) {
+        return a.policy < b.policy;
+    });
+
+    printf("relative errors of the inverse square root, integration over 60 s at %d Hz\n", SampleRate);
+    printf("%-10s %10s %10s %12s %12s %10s %10s %10s\n", "policy", "1e-6..1e6", "near 1", "drift deg",
+           "|q|-1", "ns/isqrt", "ns/vector", "ns/quat");
+    for (const inverse_sqrt_build &build : builds) {
+        double angle;
+        double magnitude_error;
+        integrate(build, angle, magnitude_error);
+
+        double isqrt_ns = time_calls(samples, [&](int i) {
+            return build.inverse_sqrt(near_one[i]);
+        });
+        double vector_ns = time_calls(samples, [&](int i) {
+            return build.vector_normalise(vectors[i & (inputs - 1)]).axis.x;
+        });
+        double quaternion_ns = time_calls(samples, [&](int i) {
+            return build.quaternion_normalise(quaternions[i & (inputs - 1)]).element.w;
+        });
+
+        printf("%-10s %10.2e %10.2e %12.2e %12.2e %10.2f %10.2f %10.2f\n", build.name,
+               relative_error(build, wide), relative_error(build, near_one), angle, magnitude_error,
+               isqrt_ns, vector_ns, quaternion_ns);
+    }
+    return 0;
+}
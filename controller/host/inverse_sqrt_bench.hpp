@@ -0,0 +1,36 @@
+#ifndef INVERSE_SQRT_BENCH_HPP
+#define INVERSE_SQRT_BENCH_HPP
+
+#include <vector>
+
+#include "Fusion/Fusion.h"
+
+/**
+ * @brief One FUSION_INVERSE_SQRT policy for blockbash-inverse-sqrt-bench.
+ */
+struct inverse_sqrt_build {
+    int policy;
+    const char *name;
+    float (*inverse_sqrt)(float x);
+    FusionVector (*vector_normalise)(FusionVector vector);
+    FusionQuaternion (*quaternion_normalise)(FusionQuaternion quaternion);
+};
+
+/**
+ * @brief The policies linked in, inverse_sqrt_policy.cpp adds one per
+ * compilation.
+ */
+inline std::vector<inverse_sqrt_build> &inverse_sqrt_builds()
+{
+    static std::vector<inverse_sqrt_build> builds;
+    return builds;
+}
+
+struct inverse_sqrt_registration {
+    explicit inverse_sqrt_registration(const inverse_sqrt_build &build)
+    {
+        inverse_sqrt_builds().push_back(build);
+    }
+};
+
+#endif
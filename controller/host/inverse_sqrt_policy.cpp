@@ -0,0 +1,36 @@
+/**
+ * @file inverse_sqrt_policy.cpp
+ *
+ * @brief FusionInverseSqrt and the normalisations using it, as
+ * FUSION_INVERSE_SQRT selects them. Compiled once per policy for
+ * blockbash-inverse-sqrt-bench, each compilation registering its build.
+ */
+
+#include "inverse_sqrt_bench.hpp"
+
+static float inverse_sqrt(float x)
+{
+    return FusionInverseSqrt(x);
+}
+
+static FusionVector vector_normalise(FusionVector vector)
+{
+    return FusionVectorNormalise(vector);
+}
+
+static FusionQuaternion quaternion_normalise(FusionQuaternion quaternion)
+{
+    return FusionQuaternionNormalise(quaternion);
+}
+
+#if FUSION_INVERSE_SQRT == FUSION_INVERSE_SQRT_BIT_HACK
+#define POLICY_NAME "bit hack"
+#elif FUSION_INVERSE_SQRT == FUSION_INVERSE_SQRT_HARDWARE
+#define POLICY_NAME "hardware"
+#else
+#define POLICY_NAME "newton"
+#endif
+
+static inverse_sqrt_registration registration({
+    FUSION_INVERSE_SQRT, POLICY_NAME, inverse_sqrt, vector_normalise, quaternion_normalise,
+});
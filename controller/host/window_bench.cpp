@@ -0,0 +1,250 @@
+/**
+ * @file window_bench.cpp
+ *
+ * @brief Cost per sample of the RingWindow features, against recomputing
+ * them over the window on every sample.
+ *
+ * Both run over the same synthetic six channel IMU stream, for several
+ * window lengths, with int16_t and float samples. The incremental window
+ * should cost the same per sample whatever its length, recomputing should
+ * grow with it. Before timing, the features of the incremental window are
+ * checked against the recomputed ones.
+ *
+ * Usage: blockbash-window-bench [options]
+ *   -n SAMPLES  samples per case (default 2000000)
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ring_window.hpp"
+
+static const int Channels = 6;
+
+using SteadyClock = std::chrono::steady_clock;
+
+/**
+ * Features of one channel, recomputed over the whole window.
+ */
+template<typename T, int Length, int Channels>
+struct Recomputed {
+    typedef typename ring_window_traits<T>::sum_type sum_type;
+    typedef typename ring_window_traits<T>::square_sum_type square_sum_type;
+
+    T samples[Length][Channels];
+    int head = 0;
+    int count = 0;
+
+    void add(const T *sample)
+    {
+        for (int channel = 0; channel < Channels; channel++) {
+            samples[head][channel] = sample[channel];
+        }
+        head = (head + 1) % Length;
+        if (count < Length) {
+            count++;
+        }
+    }
+
+    // oldest first
+    T at(int i, int channel) const
+    {
+        return samples[(head + Length - count + i) % Length][channel];
+    }
+
+    void features(int channel, sum_type &sum, square_sum_type &square_sum, sum_type &peak, int &crossings) const
+    {
+        sum = 0;
+        square_sum = 0;
+        peak = 0;
+        crossings = 0;
+        for (int i = 0; i < count; i++) {
+            T value = at(i, channel);
+            sum += value;
+            square_sum += (square_sum_type) value * value;
+            sum_type magnitude = value < 0 ? -(sum_type) value : (sum_type) value;
+            if (magnitude > peak) {
+                peak = magnitude;
+            }
+            if (i > 0 && (value < 0) != (at(i - 1, channel) < 0)) {
+                crossings++;
+            }
+        }
+    }
+};
+
+/**
+ * A wrist waving about: slow sines on every channel, noise and the odd
+ * spike.
+ */
+template<typename T>
+static std::vector<T> make_stream(int samples)
+{
+    std::vector<T> stream(samples * Channels);
+    std::minstd_rand random(1);
+    std::normal_distribution<float> noise(0, 300);
+    for (int i = 0; i < samples; i++) {
+        for (int channel = 0; channel < Channels; channel++) {
+            float value = 8000 * std::sin(i * 0.01f * (channel + 1)) + noise(random);
+            if (random() % 500 == 0) {
+                value *= 3;
+            }
+            value = value > 32767 ? 32767 : value < -32768 ? -32768 : value;
+            stream[i * Channels + channel] = (T) value;
+        }
+    }
+    return stream;
+}
+
+/**
+ * Within tolerance of scale, the size of what was summed: float sums of
+ * samples cancelling out keep the rounding of the samples themselves.
+ */
+template<typename T>
+static bool close(T a, T b, double tolerance, double scale)
+{
+    return std::fabs((double) a - (double) b) <= tolerance * (1 + scale);
+}
+
+/**
+ * @return the number of samples whose features differ.
+ */
+template<typename T, int Length>
+static int check(const std::vector<T> &stream)
+{
+    typedef RingWindow<T, Length, Channels> Window;
+    static Window window;
+    static Recomputed<T, Length, Channels> recomputed;
+    window.reset();
+    recomputed = Recomputed<T, Length, Channels>();
+
+    // exact in integers, within float rounding otherwise
+    double tolerance = ring_window_traits<T>::exact ? 0 : 1e-4;
+    int samples = (int) stream.size() / Channels;
+    int bad = 0;
+    for (int i = 0; i < samples; i++) {
+        window.add(&stream[i * Channels]);
+        recomputed.add(&stream[i * Channels]);
+        for (int channel = 0; channel < Channels; channel++) {
+            typename Window::sum_type sum, peak;
+            typename Window::square_sum_type square_sum;
+            int crossings;
+            recomputed.features(channel, sum, square_sum, peak, crossings);
+            // |sum| is at most sqrt(count * square_sum)
+            double scale = std::sqrt((double) square_sum * window.size());
+            if (!close(window.sum(channel), sum, tolerance, scale)
+                || !close(window.square_sum(channel), square_sum, tolerance, (double) square_sum)
+                || window.peak(channel) != peak
+                || window.zero_crossings(channel) != crossings) {
+                bad++;
+                break;
+            }
+        }
+    }
+    return bad;
+}
+
+/**
+ * Feed the stream and read every feature of every channel after each
+ * sample, as the recognizer would.
+ */
+template<typename T, int Length>
+static double incremental_ns(const std::vector<T> &stream)
+{
+    static RingWindow<T, Length, Channels> window;
+    window.reset();
+
+    int samples = (int) stream.size() / Channels;
+    double checksum = 0;
+    SteadyClock::time_point start = SteadyClock::now();
+    for (int i = 0; i < samples; i++) {
+        window.add(&stream[i * Channels]);
+        for (int channel = 0; channel < Channels; channel++) {
+            checksum += window.mean(channel) + window.variance(channel) + window.energy(channel)
+                      + window.peak(channel) + window.zero_crossings(channel);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    // keep the features from being optimized away
+    if (checksum == 1) {
+        printf(" ");
+    }
+    return elapsed.count() / samples;
+}
+
+template<typename T, int Length>
+static double recomputed_ns(const std::vector<T> &stream)
+{
+    typedef Recomputed<T, Length, Channels> Window;
+    static Window window;
+    window = Window();
+
+    int samples = (int) stream.size() / Channels;
+    double checksum = 0;
+    SteadyClock::time_point start = SteadyClock::now();
+    for (int i = 0; i < samples; i++) {
+        window.add(&stream[i * Channels]);
+        for (int channel = 0; channel < Channels; channel++) {
+            typename Window::sum_type sum, peak;
+            typename Window::square_sum_type square_sum;
+            int crossings;
+            window.features(channel, sum, square_sum, peak, crossings);
+            checksum += sum + square_sum + peak + crossings;
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    if (checksum == 1) {
+        printf(" ");
+    }
+    return elapsed.count() / samples;
+}
+
+template<typename T, int Length>
+static void run_case(const char *type, const std::vector<T> &stream, const std::vector<T> &check_stream)
+{
+    int bad = check<T, Length>(check_stream);
+    printf("%-7s %6d %12.1f %12.1f %8d\n", type, Length,
+           incremental_ns<T, Length>(stream), recomputed_ns<T, Length>(stream), bad);
+}
+
+template<typename T>
+static void run_type(const char *type, int samples)
+{
+    std::vector<T> stream = make_stream<T>(samples);
+    std::vector<T> check_stream = make_stream<T>(20000);
+    run_case<T, 8>(type, stream, check_stream);
+    run_case<T, 32>(type, stream, check_stream);
+    run_case<T, 128>(type, stream, check_stream);
+    run_case<T, 512>(type, stream, check_stream);
+}
+
+int main(int argc, char **argv)
+{
+    int samples = 2000000;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:h")) != -1) {
+        switch (option) {
+        case 'n': samples = std::atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (samples <= 0) {
+        fprintf(stderr, "samples must be positive\n");
+        return 1;
+    }
+
+    printf("%d samples of %d channels per case, features read after every sample\n", samples, Channels);
+    printf("%-7s %6s %12s %12s %8s\n", "samples", "length", "window ns", "recompute ns", "mismatch");
+    run_type<int16_t>("int16", samples);
+    run_type<float>("float", samples);
+    return 0;
+}
@@ -1,11 +1,18 @@
-#include "lab3.hpp"
+#include "mbed.h"
+
+#include "gesture_pipeline.hpp"
+
+/**
+ * @brief Print a recognized gesture, only its action code and magnitude.
+ * The BLE controller firmware publishes them to the console instead.
+ */
+static void print_gesture(const gesture &recognized)
+{
+    printf("GESTURE 0x%02x %u\n", recognized.action, recognized.magnitude);
+}
 
-#include "mbed.h" 
 // main() runs in its own thread in the OS
 int main()
 {
-    while (true) {
-
-    }
+    run_gesture_pipeline(callback(print_gesture));
 }
-
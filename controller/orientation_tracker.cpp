@@ -0,0 +1,130 @@
+#include <stdint.h>
+
+#include "orientation_tracker.hpp"
+#include "lsm6dsl.h"
+
+// Raw counts to dps and g, at the full scales set by sensors_init()
+#define GYRO_DPS_PER_COUNT      (LSM6DSL_GYRO_SENSITIVITY_2000DPS / 1000.0f)
+#define ACCEL_G_PER_COUNT       (LSM6DSL_ACC_SENSITIVITY_2G / 1000.0f)
+
+// Accelerometer ignored while it is more than 10 degrees off the
+// orientation, for at most 5 s
+#define ACCELERATION_REJECTION  10.0f
+#define RECOVERY_TRIGGER_PERIOD (5 * IMU_FIFO_ODR_HZ)
+
+OrientationTracker::OrientationTracker()
+{
+    FusionOffsetInitialise(&offset, IMU_FIFO_ODR_HZ);
+    FusionAhrsInitialise(&ahrs);
+
+    FusionAhrsSettings settings;
+    settings.convention = FusionConventionNwu;
+    settings.gain = 0.5f;
+    settings.gyroscopeRange = 2000.0f;
+    settings.accelerationRejection = ACCELERATION_REJECTION;
+    settings.magneticRejection = 0.0f;
+    settings.recoveryTriggerPeriod = RECOVERY_TRIGGER_PERIOD;
+    FusionAhrsSetSettings(&ahrs, &settings);
+}
+
+/**
+ * @brief Scale a sample to dps and g and take the gyroscope offset out.
+ */
+static void convert_sample(FusionOffset &offset, const imu_sample &sample,
+                           FusionVector &gyroscope, FusionVector &accelerometer)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        gyroscope.array[axis] = sample.gyro[axis] * GYRO_DPS_PER_COUNT;
+        accelerometer.array[axis] = sample.accel[axis] * ACCEL_G_PER_COUNT;
+    }
+    gyroscope = FusionOffsetUpdate(&offset, gyroscope);
+}
+
+void OrientationTracker::add_sample(const imu_sample &sample)
+{
+    FusionVector gyroscope;
+    FusionVector accelerometer;
+    convert_sample(offset, sample, gyroscope, accelerometer);
+    FusionAhrsUpdateNoMagnetometer(&ahrs, gyroscope, accelerometer, 1.0f / IMU_FIFO_ODR_HZ);
+}
+
+/**
+ * @brief Scale back to raw counts, saturated as the sensor would.
+ */
+static int16_t to_counts(float value, float per_count)
+{
+    float counts = value / per_count;
+    return counts > INT16_MAX ? INT16_MAX : counts < INT16_MIN ? INT16_MIN : (int16_t) counts;
+}
+
+/**
+ * @brief The accelerometer reading with gravity taken out, as
+ * FusionAhrsGetLinearAcceleration() does for the latest sample.
+ */
+static FusionVector remove_gravity(const FusionQuaternion &quaternion, const FusionVector &accelerometer)
+{
+    const float w = quaternion.element.w;
+    const float x = quaternion.element.x;
+    const float y = quaternion.element.y;
+    const float z = quaternion.element.z;
+
+    // third column of the transposed rotation matrix, NWU
+    FusionVector linear;
+    linear.axis.x = accelerometer.axis.x - 2.0f * (x * z - w * y);
+    linear.axis.y = accelerometer.axis.y - 2.0f * (y * z + w * x);
+    linear.axis.z = accelerometer.axis.z - 2.0f * (w * w - 0.5f + z * z);
+    return linear;
+}
+
+void OrientationTracker::add_samples(const imu_sample *samples, int count)
+{
+    add_samples(samples, count, NULL);
+}
+
+void OrientationTracker::add_samples(const imu_sample *samples, int count, imu_sample *tracked)
+{
+    FusionVector gyroscope[BatchLength];
+    FusionVector accelerometer[BatchLength];
+
+    while (count > 0) {
+        int length = count < BatchLength ? count : BatchLength;
+        for (int i = 0; i < length; i++) {
+            convert_sample(offset, samples[i], gyroscope[i], accelerometer[i]);
+        }
+        FusionAhrsUpdateBatch(&ahrs, gyroscope, accelerometer, length, 1.0f / IMU_FIFO_ODR_HZ,
+                              tracked ? quaternions : NULL, 1);
+
+        if (tracked) {
+            for (int i = 0; i < length; i++) {
+                FusionVector linear = remove_gravity(quaternions[i], accelerometer[i]);
+                for (int axis = 0; axis < 3; axis++) {
+                    tracked[i].gyro[axis] = to_counts(gyroscope[i].array[axis], GYRO_DPS_PER_COUNT);
+                    tracked[i].accel[axis] = to_counts(linear.array[axis], ACCEL_G_PER_COUNT);
+                }
+            }
+            tracked += length;
+        }
+        samples += length;
+        count -= length;
+    }
+}
+
+FusionQuaternion OrientationTracker::get_quaternion() const
+{
+    return FusionAhrsGetQuaternion(&ahrs);
+}
+
+FusionEuler OrientationTracker::get_euler() const
+{
+    return FusionQuaternionToEuler(FusionAhrsGetQuaternion(&ahrs));
+}
+
+FusionVector OrientationTracker::get_linear_acceleration() const
+{
+    return FusionAhrsGetLinearAcceleration(&ahrs);
+}
+
+bool OrientationTracker::is_initialising() const
+{
+    return FusionAhrsGetFlags(&ahrs).initialising;
+}
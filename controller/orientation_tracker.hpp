@@ -0,0 +1,65 @@
+#ifndef ORIENTATION_TRACKER_HPP
+#define ORIENTATION_TRACKER_HPP
+
+#include "sensor-data.hpp"
+#include "Fusion/Fusion.h"
+
+/**
+ * @brief Tracks the board orientation from the IMU sample stream with the
+ * Fusion AHRS, one sample at a time at the FIFO rate.
+ *
+ * The gyroscope offset is recalibrated whenever the board stays still for
+ * a few seconds. The accelerometer pulls the orientation back towards
+ * gravity, except while it reads well off 1 g, so shaking the board does
+ * not tilt it. There is no magnetometer, the heading drifts.
+ *
+ * The orientation gives the linear acceleration, the accelerometer reading
+ * with gravity removed, whatever way the board is held.
+ */
+class OrientationTracker {
+public:
+    OrientationTracker();
+
+    /**
+     * @brief Feed the next sample, at IMU_FIFO_ODR_HZ.
+     */
+    void add_sample(const imu_sample &sample);
+
+    /**
+     * @brief Feed a FIFO batch, consecutive samples at IMU_FIFO_ODR_HZ,
+     * through one batched AHRS update.
+     */
+    void add_samples(const imu_sample *samples, int count);
+
+    /**
+     * @brief Feed a FIFO batch as add_samples() does and give each sample
+     * back as the tracker sees it, in raw counts: the gyroscope with its
+     * offset taken out, the accelerometer with gravity taken out at the
+     * orientation of that sample.
+     *
+     * @param tracked room for count samples.
+     */
+    void add_samples(const imu_sample *samples, int count, imu_sample *tracked);
+
+    FusionQuaternion get_quaternion() const;
+
+    FusionEuler get_euler() const;
+
+    /**
+     * @brief Acceleration with gravity removed, in g, in the board frame.
+     */
+    FusionVector get_linear_acceleration() const;
+
+    bool is_initialising() const;
+
+private:
+    // samples converted for one batched update
+    static const int BatchLength = 32;
+
+    FusionOffset offset;
+    FusionAhrs ahrs;
+    // orientation after each sample of a batch, for the tracked samples
+    FusionQuaternion quaternions[BatchLength];
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef RING_WINDOW_HPP
+#define RING_WINDOW_HPP
+
+#include <stdint.h>
+
+/**
+ * @brief Accumulator types for the samples of a RingWindow.
+ *
+ * Integer samples are summed exactly in wider integers. Float samples are
+ * summed in floats, which drift as samples are added and removed, so their
+ * sums are rebuilt over every pass of the window.
+ */
+template<typename T>
+struct ring_window_traits;
+
+template<>
+struct ring_window_traits<int16_t> {
+    typedef int32_t sum_type;
+    typedef int64_t square_sum_type;
+    static const bool exact = true;
+};
+
+template<>
+struct ring_window_traits<float> {
+    typedef float sum_type;
+    typedef float square_sum_type;
+    static const bool exact = false;
+};
+
+/**
+ * @brief The last Length samples of Channels channels and their features:
+ * mean, variance, energy, peak and zero crossings per channel.
+ *
+ * Features are kept up to date as samples come in rather than computed
+ * over the window when asked:
+ * - sums and sums of squares, for the mean, variance and energy, gain the
+ *   new sample and lose the one leaving the window;
+ * - zero crossings count the sign changes between neighbouring samples,
+ *   gaining the one at the new end and losing the one at the old end;
+ * - the peak, the largest magnitude, is the front of a queue of samples
+ *   in decreasing magnitude, where a new sample removes the smaller ones
+ *   before it.
+ *
+ * Everything is O(1) per sample, the peak amortized: a sample enters and
+ * leaves its queue once. Nothing is allocated.
+ */
+template<typename T, int Length, int Channels>
+class RingWindow {
+    static_assert(Length >= 2 && Length < 0x10000, "window positions are kept on 16 bits");
+    static_assert(Channels >= 1, "at least one channel");
+
+public:
+    typedef typename ring_window_traits<T>::sum_type sum_type;
+    typedef typename ring_window_traits<T>::square_sum_type square_sum_type;
+
+    RingWindow()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        head = 0;
+        count = 0;
+        for (int channel = 0; channel < Channels; channel++) {
+            sums[channel] = 0;
+            square_sums[channel] = 0;
+            next_sums[channel] = 0;
+            next_square_sums[channel] = 0;
+            crossings[channel] = 0;
+            peak_front[channel] = 0;
+            peak_size[channel] = 0;
+        }
+    }
+
+    /**
+     * @brief Add one sample, Channels values, dropping the oldest one once
+     * the window is full.
+     */
+    void add(const T *sample)
+    {
+        int previous = (head + Length - 1) % Length;
+        int next_oldest = (head + 1) % Length;
+        bool evict = count == Length;
+
+        for (int channel = 0; channel < Channels; channel++) {
+            T value = sample[channel];
+
+            if (evict) {
+                T oldest = samples[head][channel];
+                sums[channel] -= oldest;
+                square_sums[channel] -= (square_sum_type) oldest * oldest;
+                if ((oldest < 0) != (samples[next_oldest][channel] < 0)) {
+                    crossings[channel]--;
+                }
+                if (peak_size[channel] > 0 && peak_queue[channel][peak_front[channel]] == head) {
+                    peak_front[channel] = (peak_front[channel] + 1) % Length;
+                    peak_size[channel]--;
+                }
+            }
+            if (count > 0 && (value < 0) != (samples[previous][channel] < 0)) {
+                crossings[channel]++;
+            }
+
+            sums[channel] += value;
+            square_sums[channel] += (square_sum_type) value * value;
+            samples[head][channel] = value;
+            push_peak(channel, value);
+
+            if (!ring_window_traits<T>::exact) {
+                next_sums[channel] += value;
+                next_square_sums[channel] += (square_sum_type) value * value;
+            }
+        }
+
+        if (count < Length) {
+            count++;
+        }
+        head = next_oldest;
+
+        // the window has been replaced since the last rebuild, swap in the
+        // sums of what it holds now
+        if (!ring_window_traits<T>::exact && head == 0) {
+            for (int channel = 0; channel < Channels; channel++) {
+                sums[channel] = next_sums[channel];
+                square_sums[channel] = next_square_sums[channel];
+                next_sums[channel] = 0;
+                next_square_sums[channel] = 0;
+            }
+        }
+    }
+
+    bool full() const
+    {
+        return count == Length;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    sum_type sum(int channel) const
+    {
+        return sums[channel];
+    }
+
+    square_sum_type square_sum(int channel) const
+    {
+        return square_sums[channel];
+    }
+
+    sum_type mean(int channel) const
+    {
+        return count ? sums[channel] / count : 0;
+    }
+
+    /**
+     * @brief Variance times the sample count squared, exact in integers.
+     */
+    square_sum_type scaled_variance(int channel) const
+    {
+        square_sum_type variance = square_sums[channel] * count
+                                 - (square_sum_type) sums[channel] * sums[channel];
+        // float sums can cancel to slightly below zero
+        return variance > 0 ? variance : 0;
+    }
+
+    square_sum_type variance(int channel) const
+    {
+        return count ? scaled_variance(channel) / ((square_sum_type) count * count) : 0;
+    }
+
+    /**
+     * @brief Mean of the squared samples.
+     */
+    square_sum_type energy(int channel) const
+    {
+        return count ? square_sums[channel] / count : 0;
+    }
+
+    /**
+     * @brief Largest magnitude in the window.
+     */
+    sum_type peak(int channel) const
+    {
+        return peak_size[channel] ? magnitude(samples[peak_queue[channel][peak_front[channel]]][channel]) : 0;
+    }
+
+    /**
+     * @brief Sign changes between neighbouring samples, zero counting as
+     * positive.
+     */
+    int zero_crossings(int channel) const
+    {
+        return crossings[channel];
+    }
+
+private:
+    static sum_type magnitude(T value)
+    {
+        return value < 0 ? -(sum_type) value : (sum_type) value;
+    }
+
+    void push_peak(int channel, T value)
+    {
+        sum_type value_magnitude = magnitude(value);
+        uint16_t *queue = peak_queue[channel];
+
+        while (peak_size[channel] > 0) {
+            int back = (peak_front[channel] + peak_size[channel] - 1) % Length;
+            if (magnitude(samples[queue[back]][channel]) > value_magnitude) {
+                break;
+            }
+            peak_size[channel]--;
+        }
+        queue[(peak_front[channel] + peak_size[channel]) % Length] = head;
+        peak_size[channel]++;
+    }
+
+    T samples[Length][Channels];
+    int head;
+    int count;
+
+    sum_type sums[Channels];
+    square_sum_type square_sums[Channels];
+    // sums since the window last started over, for float samples
+    sum_type next_sums[Channels];
+    square_sum_type next_square_sums[Channels];
+
+    int crossings[Channels];
+
+    // window positions of the peak candidates, decreasing in magnitude
+    uint16_t peak_queue[Channels][Length];
+    int peak_front[Channels];
+    int peak_size[Channels];
+};
+
+#endif
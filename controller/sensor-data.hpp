@@ -1,8 +1,91 @@
 #ifndef SENSOR_DATA
 #define SENSOR_DATA
 
+#include <stdint.h>
+
+#include "mbed.h"
+
+// Rate both sensors sample at into the FIFO
+#define IMU_FIFO_ODR_HZ         416
 
 /** 
  * @brief Initialize the accelerometer and and gyroscope
  */ 
 void sensors_init();
+
+/**
+ * @brief One gyroscope and accelerometer sample set, in raw counts, laid
+ * out as the LSM6DSL stores it in its FIFO.
+ */
+struct imu_sample {
+    int16_t gyro[3];
+    int16_t accel[3];
+};
+
+/**
+ * @brief FIFO sampling counters, for comparing with the polling loop.
+ */
+struct imu_fifo_stats {
+    uint32_t wakeups;       // times the sensor thread woke up
+    uint32_t drains;        // burst reads of the FIFO
+    uint32_t samples;       // sample sets read
+    uint32_t overruns;      // times the FIFO filled up before a drain
+    uint32_t realigned;     // drains that started in the middle of a set
+    // age of the oldest sample of each drain, how long samples wait
+    uint64_t age_total_us;
+    uint32_t age_max_us;
+};
+
+/**
+ * @brief Run both sensors at the FIFO rate and batch their samples in the
+ * LSM6DSL FIFO. Call after sensors_init().
+ */
+void sensors_fifo_init();
+
+/**
+ * @brief Read the complete sample sets waiting in the FIFO in one burst.
+ *
+ * @param samples room for max_samples sets, oldest first.
+ * @return the number of sets read.
+ */
+int read_imu_fifo(imu_sample *samples, int max_samples);
+
+const imu_fifo_stats &get_imu_fifo_stats();
+
+/**
+ * @brief Sample the IMU through its FIFO, handing every batch drained to
+ * on_samples from the calling thread.
+ *
+ * This function does not return.
+ */
+void start_imu_tracking(mbed::Callback<void(const imu_sample *, int)> on_samples);
+
+/**
+ * @brief Sources of an LSM6DSL embedded function interrupt.
+ */
+struct imu_events {
+    uint8_t tap_src;        // TAP_SRC
+    uint8_t d6d_src;        // D6D_SRC, the orientation after the change
+    uint32_t waited_us;     // from the interrupt to reading the sources
+};
+
+// TAP_SRC and D6D_SRC bits
+#define IMU_TAP_DOUBLE          0x10
+#define IMU_D6D_CHANGED         0x40
+#define IMU_D6D_Z_HIGH          0x20
+#define IMU_D6D_Z_LOW           0x10
+#define IMU_D6D_Y_HIGH          0x08
+#define IMU_D6D_Y_LOW           0x04
+#define IMU_D6D_X_HIGH          0x02
+#define IMU_D6D_X_LOW           0x01
+
+/**
+ * @brief Detect gestures in the LSM6DSL embedded functions instead of
+ * streaming samples, handing every interrupt to on_events. Call after
+ * sensors_init().
+ *
+ * This function does not return.
+ */
+void start_imu_events(mbed::Callback<void(const imu_events &)> on_events);
+
+#endif